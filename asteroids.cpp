@@ -0,0 +1,262 @@
+//
+//	The asteroid belt -- see asteroids.h.
+//
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "asteroids.h"
+
+// the most threads the propagation is split across:
+
+const int ASTEROID_MAX_THREADS = { 16 };
+
+// the asteroids in each job, when the propagation runs as jobs:
+// (whole blocks, several jobs per thread so a thread that finishes early
+//  can steal from one that is behind)
+
+const int ASTEROID_JOB_SIZE = { 16 * KEPLER_BLOCK };
+
+// how the eccentricities and inclinations of the belt are spread:
+
+const float ASTEROID_MAX_E   = { 0.25f };
+const float ASTEROID_MAX_INC = { 15.f };		// degrees
+
+// and those of ring particles, which stay close to circular and flat:
+
+const float RING_MAX_E   = { 0.002f };
+const float RING_MAX_INC = { 0.2f };		// degrees
+
+// how quickly the active count follows the budget:
+
+const float ASTEROID_SMOOTHING = { 0.2f };		// weight of the newest update time in avgMs
+const float ASTEROID_GROW      = { 1.05f };		// growth per update while under 3/4 of the budget
+
+
+static double
+AsteroidNowMs( )
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>( steady_clock::now( ).time_since_epoch( ) ).count( );
+}
+
+
+// a small xorshift generator, so the belt is the same on every platform
+// (rand( ) is not) and benchmark runs can be compared:
+
+static float
+AsteroidRandom( unsigned int *state )
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (float)( x >> 8 ) / (float)( 1 << 24 );		// [ 0., 1. )
+}
+
+
+// everything propagated, no budget yet:
+
+static void
+AsteroidsStart( AsteroidBelt *ab )
+{
+	int n = ab->orbits.n;
+	ab->active = n;
+	ab->minActive = std::min( n, 4 * KEPLER_BLOCK );
+	ab->budgetMs = 0.;
+	ab->lastMs = ab->avgMs = 0.;
+	ab->threads = std::max( 1, std::min( (int)std::thread::hardware_concurrency( ), ASTEROID_MAX_THREADS ) );
+	ab->jobs = NULL;
+}
+
+
+// fill the belt with n asteroids with semi-major axes between amin and amax:
+// (periods follow Kepler's third law, period = periodScale * a^1.5, as the planets' do)
+
+void
+AsteroidsInit( AsteroidBelt *ab, int n, float amin, float amax, float periodScale, unsigned int seed )
+{
+	unsigned int state = seed != 0 ? seed : 1;
+
+	KeplerInit( &ab->orbits );
+	KeplerReserve( &ab->orbits, n );
+	for( int i = 0; i < n; i++ )
+	{
+		// more asteroids towards the inner edge, as in the real belt:
+		float r = AsteroidRandom( &state );
+		float a = amin + ( amax - amin ) * r * r;
+
+		float e    = ASTEROID_MAX_E * AsteroidRandom( &state ) * AsteroidRandom( &state );
+		float inc  = ASTEROID_MAX_INC * AsteroidRandom( &state ) * AsteroidRandom( &state );
+		float node = 360.f * AsteroidRandom( &state );
+		float peri = 360.f * AsteroidRandom( &state );
+		float M0   = 360.f * AsteroidRandom( &state );
+		KeplerAdd( &ab->orbits, a, e, inc, node, peri, M0, periodScale * a * sqrtf( a ) );
+	}
+
+	AsteroidsStart( ab );
+}
+
+
+// fill a planetary ring with n particles, shared out among the bands:
+// (the orbits are all but circular and flat in the ring plane, which is the
+//  x-z plane of whatever transform they are drawn under)
+
+void
+AsteroidsInitRings( AsteroidBelt *ab, int n, const RingBand *bands, int nbands, float periodScale, unsigned int seed )
+{
+	unsigned int state = seed != 0 ? seed : 1;
+
+	float total = 0.;
+	for( int b = 0; b < nbands; b++ )
+		total += bands[b].share;
+
+	KeplerInit( &ab->orbits );
+	KeplerReserve( &ab->orbits, n );
+	for( int i = 0; i < n; i++ )
+	{
+		// pick a band by its share, then a radius evenly across its area:
+		float pick = total * AsteroidRandom( &state );
+		int b = 0;
+		while( b < nbands - 1  &&  pick >= bands[b].share )
+			pick -= bands[b++].share;
+		float a0 = bands[b].amin * bands[b].amin;
+		float a1 = bands[b].amax * bands[b].amax;
+		float a = sqrtf( a0 + ( a1 - a0 ) * AsteroidRandom( &state ) );
+
+		float e    = RING_MAX_E * AsteroidRandom( &state );
+		float inc  = RING_MAX_INC * AsteroidRandom( &state );
+		float node = 360.f * AsteroidRandom( &state );
+		float peri = 360.f * AsteroidRandom( &state );
+		float M0   = 360.f * AsteroidRandom( &state );
+		KeplerAdd( &ab->orbits, a, e, inc, node, peri, M0, periodScale * a * sqrtf( a ) );
+	}
+
+	AsteroidsStart( ab );
+}
+
+
+// what a propagation job needs:
+
+struct PropagateArgs
+{
+	AsteroidBelt	*ab;
+	double			t;
+	float			*xyz;
+};
+
+
+static void
+PropagateJob( void *arg, int first, int count, int )
+{
+	PropagateArgs *pa = (PropagateArgs *)arg;
+	KeplerPropagate( &pa->ab->orbits, pa->t, first, count, pa->xyz + 3*first );
+}
+
+
+// propagate the active asteroids to time t (ms) into xyz[ 3*active ],
+// split into one contiguous range per thread, or into jobs:
+// (xyz may be a mapped vertex buffer -- the threads only write memory)
+
+void
+AsteroidsUpdate( AsteroidBelt *ab, double t, float *xyz )
+{
+	double start = AsteroidNowMs( );
+
+	int n = ab->active;
+	if( ab->jobs != NULL )
+	{
+		PropagateArgs pa = { ab, t, xyz };
+		JobsRun( ab->jobs, PropagateJob, &pa, n, ASTEROID_JOB_SIZE );
+	}
+	else
+	{
+		// whole blocks per thread so no block is split between two of them:
+		int nt = ab->threads;
+		int chunk = ( n + nt - 1 ) / nt;
+		chunk = ( ( chunk + KEPLER_BLOCK - 1 ) / KEPLER_BLOCK ) * KEPLER_BLOCK;
+
+		std::thread workers[ASTEROID_MAX_THREADS];
+		int nworkers = 0;
+		for( int first = chunk; first < n; first += chunk )
+		{
+			int count = std::min( chunk, n - first );
+			workers[nworkers++] = std::thread( KeplerPropagate, &ab->orbits, t, first, count, xyz + 3*first );
+		}
+		KeplerPropagate( &ab->orbits, t, 0, std::min( chunk, n ), xyz );
+		for( int w = 0; w < nworkers; w++ )
+			workers[w].join( );
+	}
+
+	ab->lastMs = (float)( AsteroidNowMs( ) - start );
+	ab->avgMs = ab->avgMs == 0. ? ab->lastMs
+		: ( 1.f - ASTEROID_SMOOTHING ) * ab->avgMs + ASTEROID_SMOOTHING * ab->lastMs;
+
+	// steer the active count towards the budget:
+	// (cut back in proportion as soon as we are over, grow slowly when well under)
+
+	if( ab->budgetMs > 0. )
+	{
+		int total = ab->orbits.n;
+		if( ab->avgMs > ab->budgetMs )
+			ab->active = (int)( (float)ab->active * 0.95f * ab->budgetMs / ab->avgMs );
+		else if( ab->avgMs < 0.75f * ab->budgetMs )
+			ab->active = (int)( (float)ab->active * ASTEROID_GROW ) + KEPLER_BLOCK;
+		ab->active = std::max( ab->minActive, std::min( ab->active, total ) );
+	}
+}
+
+
+// the dedicated benchmark -- no window, just the propagation:
+// first every thread count up to the machine's with the whole belt, then
+// the budget controller left to settle, to show how many asteroids fit
+
+void
+AsteroidsBenchmark( int n, int frames, float budgetMs )
+{
+	AsteroidBelt ab;
+	double start = AsteroidNowMs( );
+	AsteroidsInit( &ab, n, 9.f, 14.5f, 500.f, 12345 );
+	printf( "asteroids: %d bodies, init %.1f ms, %d frames, budget %.2f ms\n",
+		n, AsteroidNowMs( ) - start, frames, budgetMs );
+
+	std::vector<float> xyz( 3 * (size_t)n );
+	std::vector<double> times( frames );
+	int maxThreads = ab.threads;
+	// doubling, but with the last pass using every thread:
+	for( int nt = 1; nt <= maxThreads; nt = ( nt < maxThreads  &&  nt * 2 > maxThreads ) ? maxThreads : nt * 2 )
+	{
+		ab.threads = nt;
+		for( int f = 0; f < frames; f++ )
+		{
+			AsteroidsUpdate( &ab, 1.e6 + f * ( 1000. / 60. ), &xyz[0] );
+			times[f] = ab.lastMs;
+		}
+		std::sort( times.begin( ), times.end( ) );
+		double sum = 0.;
+		int within = 0;
+		for( int f = 0; f < frames; f++ )
+		{
+			sum += times[f];
+			if( times[f] <= budgetMs )
+				within++;
+		}
+		printf( "\t%2d threads: mean %8.3f ms  p99 %8.3f ms  %6.1f Mbodies/s  %5.1f%% of frames within budget\n",
+			nt, sum / frames, times[ std::min( frames - 1, (int)ceil( 0.99 * frames ) - 1 ) ],
+			(double)n / ( sum / frames ) / 1000., 100. * within / frames );
+	}
+
+	ab.threads = maxThreads;
+	ab.budgetMs = budgetMs;
+	for( int f = 0; f < 4 * frames; f++ )
+		AsteroidsUpdate( &ab, 1.e6 + f * ( 1000. / 60. ), &xyz[0] );
+	printf( "\tbudget of %.2f ms on %d threads settles at %d asteroids (%.3f ms)\n",
+		budgetMs, maxThreads, ab.active, ab.avgMs );
+}
@@ -0,0 +1,41 @@
+//
+//	The asteroid belt: up to a million small bodies on Keplerian orbits,
+//	propagated across all the cores every frame.
+//
+//	AsteroidsUpdate( ) measures itself and shrinks or grows the number of
+//	asteroids it propagates so that it stays inside a fixed cpu budget.
+//
+//	The same machinery drives planetary ring particles, which are just a
+//	belt of nearly circular orbits around a planet instead of the Sun.
+
+#ifndef ASTEROIDS_H
+#define ASTEROIDS_H
+
+#include "kepler.h"
+#include "jobs.h"
+
+struct AsteroidBelt
+{
+	KeplerSet	orbits;			// all the asteroids, in random order
+	int			active;			// # of them propagated each frame -- the first 'active' of orbits
+	int			minActive;		// the budget never takes 'active' below this
+	float		budgetMs;		// cpu time allowed per update, 0. means no limit
+	float		lastMs;			// what the last update took
+	float		avgMs;			// smoothed update time the budget is steered by
+	int			threads;		// # of threads the propagation is split across
+	JobSystem	*jobs;			// runs the propagation as jobs, NULL to start threads for each update
+};
+
+// a ring band: particles between amin and amax, share being its part of the whole:
+
+struct RingBand
+{
+	float	amin, amax, share;
+};
+
+void	AsteroidsInit( AsteroidBelt *, int, float, float, float, unsigned int );
+void	AsteroidsInitRings( AsteroidBelt *, int, const RingBand *, int, float, unsigned int );
+void	AsteroidsUpdate( AsteroidBelt *, double, float * );
+void	AsteroidsBenchmark( int, int, float );
+
+#endif
@@ -0,0 +1,352 @@
+//
+//	The comets -- see comets.h.
+//
+//	Distances are scene units and times are milliseconds of simulation time,
+//	as for the planets.
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "comets.h"
+
+// the most threads the comets are split across:
+
+const int COMET_MAX_THREADS = { 16 };
+
+// the comets in each job, when the update runs as jobs:
+
+const int COMET_JOB_SIZE = { 2 };
+
+// how the orbits are spread:
+// (perihelia stay clear of the Sun, which has a radius of 4.)
+
+const float COMET_AMIN   = { 12.f };
+const float COMET_AMAX   = { 40.f };
+const float COMET_QMIN   = { 6.f };
+const float COMET_QMAX   = { 9.f };
+const float COMET_MAXINC = { 180.f };		// degrees, mostly low but a few retrograde
+
+// the tails:
+// (a comet is active inside COMET_ACTIVE_R and sheds particles fastest at
+//  perihelion, in proportion to the sunlight it gets; the pushes are given at
+//  COMET_PUSH_R from the Sun and fall off as 1/r^2)
+
+const float COMET_ACTIVE_R  = { 20.f };
+const float COMET_PUSH_R    = { 6.f };
+const float COMET_DUST_LIFE = { 400.f };		// ms
+const float COMET_ION_LIFE  = { 150.f };		// ms
+const int   COMET_ION_EVERY = { 3 };			// every third slot holds an ion particle
+const float COMET_DUST_PUSH = { 4.0e-5f };		// scene units/ms^2
+const float COMET_ION_PUSH  = { 5.0e-4f };
+const float COMET_ION_SPEED = { 0.01f };		// scene units/ms, straight away from the Sun
+const float COMET_JITTER    = { 0.0005f };		// scene units/ms, spread of the dust
+
+const unsigned char COMET_DUST_COLOR[3] = { 255, 235, 190 };
+const unsigned char COMET_ION_COLOR[3]  = { 140, 180, 255 };
+
+
+static double
+CometNowMs( )
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>( steady_clock::now( ).time_since_epoch( ) ).count( );
+}
+
+
+// the same xorshift generator as the asteroid belt, one state per comet
+// so the threads never share one:
+
+static float
+CometRandom( unsigned int *state )
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (float)( x >> 8 ) / (float)( 1 << 24 );		// [ 0., 1. )
+}
+
+
+// n comets with rings of capacity particles each:
+// (periods follow Kepler's third law, period = periodScale * a^1.5, as the planets' do)
+
+void
+CometsInit( CometSystem *cs, int n, int capacity, float periodScale, unsigned int seed )
+{
+	unsigned int state = seed != 0 ? seed : 1;
+
+	KeplerInit( &cs->orbits );
+	KeplerReserve( &cs->orbits, n );
+	cs->perihelion.resize( n );
+	cs->random.resize( n );
+	for( int c = 0; c < n; c++ )
+	{
+		float a = COMET_AMIN + ( COMET_AMAX - COMET_AMIN ) * CometRandom( &state );
+		float q = COMET_QMIN + ( COMET_QMAX - COMET_QMIN ) * CometRandom( &state );
+		float r = CometRandom( &state );
+		float inc  = COMET_MAXINC * r * r * r;
+		float node = 360.f * CometRandom( &state );
+		float peri = 360.f * CometRandom( &state );
+		float M0   = 360.f * CometRandom( &state );
+		KeplerAdd( &cs->orbits, a, 1.f - q / a, inc, node, peri, M0, periodScale * a * sqrtf( a ) );
+		cs->perihelion[c] = q;
+		cs->random[c] = state ^ ( 0x9e3779b9u * ( c + 1 ) );
+	}
+
+	size_t slots = (size_t)n * capacity;
+	cs->capacity = capacity;
+	cs->owed.assign( n, 0.f );
+	cs->head.assign( n, 0 );
+	cs->birth.assign( slots, -1.e30 );
+	cs->px.resize( slots );  cs->py.resize( slots );  cs->pz.resize( slots );
+	cs->vx.resize( slots );  cs->vy.resize( slots );  cs->vz.resize( slots );
+	cs->ax.resize( slots );  cs->ay.resize( slots );  cs->az.resize( slots );
+	cs->nucleus.assign( 3 * (size_t)n, 0.f );
+	cs->first.resize( n );
+	cs->count.assign( n, 0 );
+	for( int c = 0; c < n; c++ )
+		cs->first[c] = c * capacity;
+
+	cs->lastT = 0.;
+	cs->started = false;
+	cs->threads = std::max( 1, std::min( (int)std::thread::hardware_concurrency( ), COMET_MAX_THREADS ) );
+	cs->jobs = NULL;
+	cs->live = 0;
+	cs->lastMs = 0.;
+}
+
+
+// shed comet c's particles for the time since t0, then write its live
+// particles as they are at t1 into out[ first[c] ... ]:
+
+static void
+UpdateComet( CometSystem *cs, int c, double t0, double t1, const float light[3], CometVertex *out )
+{
+	int cap = cs->capacity;
+	size_t base = (size_t)c * cap;
+
+	// where the nucleus is and how fast it is going:
+
+	float p1[3], pm[3];
+	KeplerPropagate( &cs->orbits, t1, c, 1, p1 );
+	KeplerPropagate( &cs->orbits, t1 - 1., c, 1, pm );
+	float nv[3] = { p1[0] - pm[0], p1[1] - pm[1], p1[2] - pm[2] };
+	cs->nucleus[3*c+0] = p1[0];
+	cs->nucleus[3*c+1] = p1[1];
+	cs->nucleus[3*c+2] = p1[2];
+
+	// the particles it is due, spread evenly over the time since the last update:
+	// (nothing older than a dust particle's life would still show, so a long
+	//  jump in time only sheds that much)
+
+	double start = std::max( t0, t1 - (double)COMET_DUST_LIFE );
+	float window = (float)( t1 - start );
+	float dx = p1[0] - light[0], dy = p1[1] - light[1], dz = p1[2] - light[2];
+	float r = sqrtf( dx*dx + dy*dy + dz*dz );
+	float rate = 0.;
+	if( r < COMET_ACTIVE_R )
+	{
+		float q = cs->perihelion[c];
+		rate = (float)cap / COMET_DUST_LIFE * std::min( 1.f, q*q / ( r*r ) );
+	}
+	float due = rate * window + cs->owed[c];
+	int emit = std::min( (int)due, cap );
+	cs->owed[c] = due - (float)(int)due;
+
+	if( emit > 0 )
+	{
+		float p0[3];
+		KeplerPropagate( &cs->orbits, start, c, 1, p0 );
+		unsigned int *state = &cs->random[c];
+		int h = cs->head[c];
+		for( int k = 0; k < emit; k++ )
+		{
+			float f = (float)( k + 1 ) / (float)emit;
+			float x = p0[0] + f * ( p1[0] - p0[0] );
+			float y = p0[1] + f * ( p1[1] - p0[1] );
+			float z = p0[2] + f * ( p1[2] - p0[2] );
+
+			// straight away from the light, pushed harder closer in:
+			float ux = x - light[0], uy = y - light[1], uz = z - light[2];
+			float rr = sqrtf( ux*ux + uy*uy + uz*uz );
+			rr = std::max( rr, 1.e-3f );
+			ux /= rr;  uy /= rr;  uz /= rr;
+			float falloff = COMET_PUSH_R * COMET_PUSH_R / ( rr * rr );
+
+			size_t s = base + h;
+			cs->birth[s] = start + (double)( f * window );
+			cs->px[s] = x;
+			cs->py[s] = y;
+			cs->pz[s] = z;
+			if( h % COMET_ION_EVERY == 0 )
+			{
+				cs->vx[s] = nv[0] + COMET_ION_SPEED * ux;
+				cs->vy[s] = nv[1] + COMET_ION_SPEED * uy;
+				cs->vz[s] = nv[2] + COMET_ION_SPEED * uz;
+				float push = COMET_ION_PUSH * falloff;
+				cs->ax[s] = push * ux;
+				cs->ay[s] = push * uy;
+				cs->az[s] = push * uz;
+			}
+			else
+			{
+				cs->vx[s] = nv[0] + COMET_JITTER * ( 2.f * CometRandom( state ) - 1.f );
+				cs->vy[s] = nv[1] + COMET_JITTER * ( 2.f * CometRandom( state ) - 1.f );
+				cs->vz[s] = nv[2] + COMET_JITTER * ( 2.f * CometRandom( state ) - 1.f );
+				float push = COMET_DUST_PUSH * falloff * ( 0.5f + CometRandom( state ) );
+				cs->ax[s] = push * ux;
+				cs->ay[s] = push * uy;
+				cs->az[s] = push * uz;
+			}
+			h = h + 1 < cap ? h + 1 : 0;
+		}
+		cs->head[c] = h;
+	}
+
+	// the live particles, fading out over their lives:
+
+	CometVertex *v = &out[ cs->first[c] ];
+	int n = 0;
+	for( int i = 0; i < cap; i++ )
+	{
+		size_t s = base + i;
+		float age = (float)( t1 - cs->birth[s] );
+		bool ion = i % COMET_ION_EVERY == 0;
+		float life = ion ? COMET_ION_LIFE : COMET_DUST_LIFE;
+		if( age < 0.  ||  age >= life )
+			continue;
+		float half = 0.5f * age * age;
+		v[n].x = cs->px[s] + age * cs->vx[s] + half * cs->ax[s];
+		v[n].y = cs->py[s] + age * cs->vy[s] + half * cs->ay[s];
+		v[n].z = cs->pz[s] + age * cs->vz[s] + half * cs->az[s];
+		const unsigned char *color = ion ? COMET_ION_COLOR : COMET_DUST_COLOR;
+		v[n].rgba[0] = color[0];
+		v[n].rgba[1] = color[1];
+		v[n].rgba[2] = color[2];
+		v[n].rgba[3] = (unsigned char)( 255.f * ( 1.f - age / life ) );
+		n++;
+	}
+	cs->count[c] = n;
+}
+
+
+static void
+UpdateComets( CometSystem *cs, int c0, int c1, double t0, double t1, const float light[3], CometVertex *out )
+{
+	for( int c = c0; c < c1; c++ )
+		UpdateComet( cs, c, t0, t1, light, out );
+}
+
+
+// what an update job needs:
+
+struct CometArgs
+{
+	CometSystem		*cs;
+	double			t0, t1;
+	const float		*light;
+	CometVertex		*out;
+};
+
+
+static void
+CometJob( void *arg, int first, int count, int )
+{
+	CometArgs *ca = (CometArgs *)arg;
+	UpdateComets( ca->cs, first, first + count, ca->t0, ca->t1, ca->light, ca->out );
+}
+
+
+// advance the comets to time t (ms), the Sun's light being at light[ ], and
+// write their live tail particles into out[ ncomets * capacity ]:
+// comet c's are out[ first[c] ... first[c] + count[c] - 1 ]; returns how
+// many there are in all
+// (out may be a mapped vertex buffer -- the threads only write memory;
+//  when t goes backwards the tails are cleared and grow again)
+
+int
+CometsUpdate( CometSystem *cs, double t, const float light[3], CometVertex *out )
+{
+	double start = CometNowMs( );
+
+	if( ! cs->started  ||  t < cs->lastT )
+	{
+		std::fill( cs->birth.begin( ), cs->birth.end( ), -1.e30 );
+		std::fill( cs->owed.begin( ), cs->owed.end( ), 0.f );
+		cs->lastT = t;
+		cs->started = true;
+	}
+
+	int n = cs->orbits.n;
+	if( cs->jobs != NULL )
+	{
+		CometArgs ca = { cs, cs->lastT, t, light, out };
+		JobsRun( cs->jobs, CometJob, &ca, n, COMET_JOB_SIZE );
+	}
+	else
+	{
+		int nt = std::min( cs->threads, std::max( n, 1 ) );
+		int chunk = ( n + nt - 1 ) / nt;
+
+		std::thread workers[COMET_MAX_THREADS];
+		int nworkers = 0;
+		for( int first = chunk; first < n; first += chunk )
+		{
+			int last = std::min( first + chunk, n );
+			workers[nworkers++] = std::thread( UpdateComets, cs, first, last, cs->lastT, t, light, out );
+		}
+		UpdateComets( cs, 0, std::min( chunk, n ), cs->lastT, t, light, out );
+		for( int w = 0; w < nworkers; w++ )
+			workers[w].join( );
+	}
+
+	cs->lastT = t;
+	cs->live = 0;
+	for( int c = 0; c < n; c++ )
+		cs->live += cs->count[c];
+	cs->lastMs = (float)( CometNowMs( ) - start );
+	return cs->live;
+}
+
+
+// the comet benchmark -- ncomets comets all at perihelion, shedding into
+// rings of capacity particles for steps frames of 16 ms:
+
+void
+CometsBenchmark( int ncomets, int capacity, int steps )
+{
+	CometSystem cs;
+	CometsInit( &cs, ncomets, capacity, 500.f, 12345 );
+
+	// start every comet at perihelion so all of them are shedding:
+	for( int c = 0; c < ncomets; c++ )
+		cs.orbits.M0[c] = 0.;
+
+	std::vector<CometVertex> out( (size_t)ncomets * capacity );
+	float light[3] = { 0., 0., 0. };
+	double t = 0.;
+	double total = 0.;
+	double particles = 0.;
+	for( int s = 0; s < steps; s++ )
+	{
+		CometsUpdate( &cs, t, light, &out[0] );
+		if( s > 0 )
+		{
+			total += cs.lastMs;
+			particles += cs.live;
+		}
+		t += 16.;
+	}
+
+	int timed = std::max( steps - 1, 1 );
+	printf( "comets: %d comets x %d particles, %d threads\n", ncomets, capacity, cs.threads );
+	printf( "\t%9.3f ms/update  %9.0f live particles  %8.2f Mparticles/s\n",
+		total / timed, particles / timed, particles / total / 1000. );
+}
@@ -0,0 +1,60 @@
+//
+//	Comets: nuclei on long, highly eccentric Kepler orbits, each shedding a
+//	dust tail and an ion tail.
+//
+//	Every comet owns a fixed-capacity ring buffer of tail particles. A new
+//	particle takes the oldest slot, so nothing is allocated once the comets
+//	are set up. A particle is not integrated. It keeps where and when it left
+//	the nucleus, its velocity then and its push away from the Sun, and its
+//	position is worked out from those at any later time. Ion particles are
+//	pushed hard and make a straight tail pointing away from the light. Dust
+//	particles are pushed gently and fall behind the nucleus into a curved tail.
+
+#ifndef COMETS_H
+#define COMETS_H
+
+#include <vector>
+
+#include "kepler.h"
+#include "jobs.h"
+
+// one tail particle as it is drawn, position then color:
+
+struct CometVertex
+{
+	float			x, y, z;
+	unsigned char	rgba[4];
+};
+
+struct CometSystem
+{
+	KeplerSet			orbits;			// the nuclei's orbits around the Sun
+	int					capacity;		// particles in each comet's ring
+	std::vector<float>	perihelion;		// each comet's closest distance to the Sun
+	std::vector<float>	owed;			// fraction of a particle each comet is due to emit
+	std::vector<int>	head;			// the next slot of each comet's ring
+	std::vector<unsigned int> random;	// each comet's random state
+
+	// each comet's ring, capacity slots apiece, all comets end to end:
+	std::vector<double>	birth;			// when the particle left the nucleus, ms
+	std::vector<float>	px, py, pz;		// where it left it
+	std::vector<float>	vx, vy, vz;		// its velocity then, scene units/ms
+	std::vector<float>	ax, ay, az;		// its push away from the Sun, scene units/ms^2
+
+	std::vector<float>	nucleus;		// the nuclei's positions at the last update
+	std::vector<int>	first;			// where each comet's live particles start in the output
+	std::vector<int>	count;			// and how many there are
+
+	double				lastT;			// time of the last update, ms
+	bool				started;		// false until the first update
+	int					threads;		// # of threads the comets are split across
+	JobSystem			*jobs;			// runs the update as jobs, NULL to start threads for each update
+	int					live;			// # of particles drawn by the last update
+	float				lastMs;			// how long the last update took
+};
+
+void	CometsInit( CometSystem *, int, int, float, unsigned int );
+int		CometsUpdate( CometSystem *, double, const float [3], CometVertex * );
+void	CometsBenchmark( int, int, int );
+
+#endif
@@ -0,0 +1,216 @@
+//
+//	Standard and reversed-Z depth -- see depth.h.
+//
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#include "depth.h"
+
+// the separations tried by DepthBenchmark( ), as multiples of its unit:
+
+const int DEPTH_GAPS = { 13 };
+
+// # of surface pairs tried at each distance:
+
+const int DEPTH_SAMPLES = { 4096 };
+
+
+const char *
+DepthModeName( int mode )
+{
+	return mode == DEPTH_REVERSED ? "reversed-Z, 32-bit float" : "standard, 24-bit";
+}
+
+
+// get ready to draw in mode:
+// (returns false, with mode made DEPTH_STANDARD, if the driver cannot clip
+//  to [0,1] or has no framebuffer objects)
+
+bool
+DepthInit( DepthBuffer *db, int mode )
+{
+	db->mode = DEPTH_STANDARD;
+	db->framebuffer = db->color = db->depth = 0;
+	db->width = db->height = 0;
+	if( mode != DEPTH_REVERSED )
+		return true;
+
+	if( ! ( GLEW_VERSION_4_5  ||  GLEW_ARB_clip_control )  ||  ! ( GLEW_VERSION_3_0  ||  GLEW_ARB_framebuffer_object )
+	  ||  ! ( GLEW_VERSION_3_0  ||  GLEW_ARB_depth_buffer_float ) )
+	{
+		fprintf( stderr, "No glClipControl( ), framebuffer objects or float depth -- reversed-Z depth is not available\n" );
+		return false;
+	}
+	glGenFramebuffers( 1, &db->framebuffer );
+	glGenRenderbuffers( 1, &db->color );
+	glGenRenderbuffers( 1, &db->depth );
+	db->mode = DEPTH_REVERSED;
+	return true;
+}
+
+
+// start the frame's scene, in a window width x height:
+
+void
+DepthBegin( DepthBuffer *db, int width, int height )
+{
+	if( db->mode != DEPTH_REVERSED )
+		return;
+
+	if( width != db->width  ||  height != db->height )
+	{
+		glBindRenderbuffer( GL_RENDERBUFFER, db->color );
+		glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+		glBindRenderbuffer( GL_RENDERBUFFER, db->depth );
+		glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height );
+		glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+		glBindFramebuffer( GL_FRAMEBUFFER, db->framebuffer );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, db->color );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, db->depth );
+		if( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+			fprintf( stderr, "The reversed-Z framebuffer is incomplete\n" );
+		db->width = width;
+		db->height = height;
+	}
+
+	glBindFramebuffer( GL_FRAMEBUFFER, db->framebuffer );
+	glDrawBuffer( GL_COLOR_ATTACHMENT0 );
+	glClipControl( GL_LOWER_LEFT, GL_ZERO_TO_ONE );
+	glClearDepth( 0. );
+	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	glDepthFunc( GL_GREATER );
+}
+
+
+// copy the scene to the window's back buffer and put the usual depth back,
+// for whatever is drawn over it:
+
+void
+DepthEnd( DepthBuffer *db )
+{
+	if( db->mode != DEPTH_REVERSED )
+		return;
+
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, db->framebuffer );
+	glBindFramebuffer( GL_DRAW_FRAMEBUFFER, 0 );
+	glDrawBuffer( GL_BACK );
+	glBlitFramebuffer( 0, 0, db->width, db->height, 0, 0, db->width, db->height, GL_COLOR_BUFFER_BIT, GL_NEAREST );
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	glClipControl( GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE );
+	glClearDepth( 1. );
+	glDepthFunc( GL_LESS );
+}
+
+
+// the projections, for the mode in use:
+// (reversed-Z's perspective ignores zfar: it reaches to infinity)
+
+void
+DepthPerspective( const DepthBuffer *db, Mat4 *a, float fovy, float aspect, float znear, float zfar )
+{
+	if( db->mode == DEPTH_REVERSED )
+		Mat4PerspectiveReversed( a, fovy, aspect, znear );
+	else
+		Mat4Perspective( a, fovy, aspect, znear, zfar );
+}
+
+
+void
+DepthOrtho( const DepthBuffer *db, Mat4 *a, float left, float right, float bottom, float top, float znear, float zfar )
+{
+	if( db->mode == DEPTH_REVERSED )
+		Mat4OrthoReversed( a, left, right, bottom, top, znear, zfar );
+	else
+		Mat4Ortho( a, left, right, bottom, top, znear, zfar );
+}
+
+
+// what each mode stores for a surface z in front of the eye, computed in
+// floats as the GPU does: a 24-bit integer, or a float's bits, which
+// compare in the same order as the non-negative floats themselves:
+
+static unsigned int
+StandardDepth( const Mat4 *proj, float z )
+{
+	float zc = proj->m[10] * -z + proj->m[14];
+	float ndc = zc / z;
+	float window = 0.5f * ndc + 0.5f;
+	if( window < 0.f )
+		window = 0.f;
+	if( window > 1.f )
+		window = 1.f;
+	return (unsigned int)( window * 16777215.f + 0.5f );
+}
+
+
+static unsigned int
+ReversedDepth( const Mat4 *proj, float z )
+{
+	float window = proj->m[14] / z;
+	unsigned int bits;
+	memcpy( &bits, &window, sizeof(bits) );
+	return bits;
+}
+
+
+// the z-fighting test: two surfaces a gap apart, at distances from near to
+// far; a pair fights when the nearer one does not get the nearer depth.
+// Nothing is rendered: the depths are those the functions above model, so
+// the test measures the depth arithmetic, not a particular GPU or driver.
+// For each distance it prints the smallest gap at which no pair fought, in
+// multiples of unit, for each mode:
+
+void
+DepthBenchmark( double znear, double zfar, double unit, double stepFactor, const char *unitName )
+{
+	Mat4 standard, reversed;
+	Mat4Perspective( &standard, 60., 1., (float)znear, (float)zfar );
+	Mat4PerspectiveReversed( &reversed, 60., 1., (float)znear );
+
+	printf( "depth: near %g, far %g %s -- smallest gap with no z-fighting over %d pairs\n",
+		znear, zfar, unitName, DEPTH_SAMPLES );
+	printf( "\t%14s  %16s  %16s\n", "distance", "standard 24-bit", "reversed float" );
+
+	unsigned int seed = 1;
+	for( double d = znear * stepFactor; d < zfar; d *= stepFactor )
+	{
+		double resolved[2] = { -1., -1. };
+		for( int mode = 0; mode < 2; mode++ )
+		{
+			const Mat4 *proj = mode == 0 ? &standard : &reversed;
+			for( int g = 0; g < DEPTH_GAPS  &&  resolved[mode] < 0.; g++ )
+			{
+				double gap = unit * pow( 10., g - 3 );
+				int fights = 0;
+				for( int s = 0; s < DEPTH_SAMPLES; s++ )
+				{
+					seed = seed * 1664525u + 1013904223u;
+					float z0 = (float)( d * ( 1. + (double)( seed >> 8 ) / 16777216. ) );
+					float z1 = (float)( z0 + gap );
+					unsigned int a, b;
+					if( mode == 0 )
+						a = StandardDepth( proj, z0 ), b = StandardDepth( proj, z1 );
+					else
+						a = ReversedDepth( proj, z1 ), b = ReversedDepth( proj, z0 );
+					if( a >= b )
+						fights++;
+				}
+				if( fights == 0 )
+					resolved[mode] = gap;
+			}
+		}
+		char cells[2][32];
+		for( int mode = 0; mode < 2; mode++ )
+		{
+			if( resolved[mode] < 0. )
+				strcpy( cells[mode], "always fights" );
+			else
+				sprintf( cells[mode], "%g %s", resolved[mode] / unit, unitName );
+		}
+		printf( "\t%10g %3s  %16s  %16s\n", d, unitName, cells[0], cells[1] );
+	}
+}
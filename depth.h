@@ -0,0 +1,52 @@
+//
+//	The depth buffer: the usual one, or reversed-Z in floating point.
+//
+//	A standard perspective projection stores roughly 1/z in a 24-bit integer
+//	depth buffer. Almost all of its values go to the first few units in
+//	front of the near plane, so far-off surfaces fight, and the further away
+//	they are, the worse it gets. Reversed-Z maps the near plane to depth 1
+//	and infinity to 0, and stores depth as a 32-bit float. A float's own
+//	precision is densest near 0, which cancels 1/z's loss with distance, and
+//	the far plane can go away altogether.
+//
+//	Reversed-Z needs a [0,1] clip range from glClipControl( ) (GL 4.5 or
+//	ARB_clip_control), and a float depth buffer, which the window may not
+//	have. The scene is therefore drawn into a framebuffer object with a
+//	GL_DEPTH_COMPONENT32F depth buffer (GL 3.0 or ARB_depth_buffer_float),
+//	and its color is blitted to the window. The mode is picked at startup,
+//	since everything that builds a projection or tests depth has to agree
+//	on it.
+
+#ifndef DEPTH_H
+#define DEPTH_H
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "glew.h"
+#include "vecmath.h"
+
+enum DepthModes
+{
+	DEPTH_STANDARD,			// glDepthFunc( GL_LESS ) into the window's own depth buffer
+	DEPTH_REVERSED,			// near = 1, infinity = 0, GL_GREATER into a float depth buffer
+};
+
+struct DepthBuffer
+{
+	int		mode;				// the one in use, DEPTH_STANDARD if DEPTH_REVERSED was not available
+	GLuint	framebuffer;		// what the scene is drawn into for DEPTH_REVERSED
+	GLuint	color, depth;		// its renderbuffers
+	int		width, height;		// their size
+};
+
+const char *	DepthModeName( int );
+bool			DepthInit( DepthBuffer *, int );
+void			DepthBegin( DepthBuffer *, int, int );
+void			DepthEnd( DepthBuffer * );
+void			DepthPerspective( const DepthBuffer *, Mat4 *, float, float, float, float );
+void			DepthOrtho( const DepthBuffer *, Mat4 *, float, float, float, float, float, float );
+void			DepthBenchmark( double, double, double, double, const char * );
+
+#endif
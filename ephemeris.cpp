@@ -0,0 +1,243 @@
+//
+//	Precomputed ephemeris tables -- see ephemeris.h.
+//
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ephemeris.h"
+
+// what the binary file starts with:
+
+const char EPHEMERIS_MAGIC[4] = { 'E', 'P', 'H', '1' };
+
+// # of points in each segment the fit is checked at:
+
+const int EPHEMERIS_CHECKS = { 7 };
+
+
+// the Chebyshev series c[0..degree] at x in [ -1., 1. ], by Clenshaw's recurrence:
+
+static inline float
+Clenshaw( const float *c, int degree, float x )
+{
+	float x2 = 2.f * x;
+	float b1 = 0.f, b2 = 0.f;
+	for( int k = degree; k >= 1; k-- )
+	{
+		float b0 = c[k] + x2 * b1 - b2;
+		b2 = b1;
+		b1 = b0;
+	}
+	return c[0] + x * b1 - b2;
+}
+
+
+// fit the bodies' positions from t0 to t1 (ms):
+//	nbodies		# of bodies
+//	periods		each body's orbital period, ms
+//	perOrbit	# of segments per orbit -- more segments, smaller errors
+//	degree		degree of the polynomials, up to EPHEMERIS_MAX_DEGREE
+//	source		the model being fitted, called degree+1 times per segment per body
+
+void
+EphemerisFit( Ephemeris *eph, int nbodies, const double *periods, int perOrbit, int degree,
+		double t0, double t1, EphemerisSource source, void *data )
+{
+	if( degree > EPHEMERIS_MAX_DEGREE )
+		degree = EPHEMERIS_MAX_DEGREE;
+	int n = degree + 1;
+	eph->nbodies = nbodies;
+	eph->degree = degree;
+	eph->t0 = t0;
+	eph->t1 = t1;
+	eph->bodies.resize( nbodies );
+	eph->coef.clear( );
+
+	// sampling at the Chebyshev nodes makes the coefficients a discrete cosine transform:
+
+	double cosines[EPHEMERIS_MAX_DEGREE+1][EPHEMERIS_MAX_DEGREE+1];
+	double nodes[EPHEMERIS_MAX_DEGREE+1];
+	for( int j = 0; j < n; j++ )
+	{
+		double theta = M_PI * ( j + 0.5 ) / n;
+		nodes[j] = cos( theta );
+		for( int k = 0; k < n; k++ )
+			cosines[k][j] = cos( k * theta );
+	}
+
+	for( int b = 0; b < nbodies; b++ )
+	{
+		EphemerisBody *eb = &eph->bodies[b];
+		eb->nsegments = (int)ceil( ( t1 - t0 ) * perOrbit / periods[b] );
+		if( eb->nsegments < 1 )
+			eb->nsegments = 1;
+		eb->segment = ( t1 - t0 ) / eb->nsegments;
+		eb->offset = (int)eph->coef.size( );
+		eph->coef.resize( eph->coef.size( ) + 3 * n * (size_t)eb->nsegments );
+
+		for( int s = 0; s < eb->nsegments; s++ )
+		{
+			double start = t0 + s * eb->segment;
+			double samples[EPHEMERIS_MAX_DEGREE+1][3];
+			for( int j = 0; j < n; j++ )
+				( *source )( data, b, start + 0.5 * eb->segment * ( nodes[j] + 1. ), samples[j] );
+
+			float *c = &eph->coef[ eb->offset + 3 * n * s ];
+			for( int axis = 0; axis < 3; axis++ )
+			{
+				for( int k = 0; k < n; k++ )
+				{
+					double sum = 0.;
+					for( int j = 0; j < n; j++ )
+						sum += samples[j][axis] * cosines[k][j];
+					c[ axis*n + k ] = (float)( ( k == 0 ? 1. : 2. ) * sum / n );
+				}
+			}
+		}
+	}
+
+	// check the fit between the nodes, where its errors are largest:
+
+	eph->maxError = 0.;
+	for( int b = 0; b < nbodies; b++ )
+	{
+		const EphemerisBody *eb = &eph->bodies[b];
+		for( int s = 0; s < eb->nsegments; s++ )
+		{
+			for( int j = 0; j < EPHEMERIS_CHECKS; j++ )
+			{
+				double t = t0 + ( s + ( j + 0.5 ) / EPHEMERIS_CHECKS ) * eb->segment;
+				double truth[3];
+				float fit[3];
+				( *source )( data, b, t, truth );
+				EphemerisEvaluate( eph, t, b, 1, fit );
+				for( int axis = 0; axis < 3; axis++ )
+				{
+					float err = (float)fabs( fit[axis] - truth[axis] );
+					if( err > eph->maxError )
+						eph->maxError = err;
+				}
+			}
+		}
+	}
+}
+
+
+bool
+EphemerisCovers( const Ephemeris *eph, double t )
+{
+	return eph->nbodies > 0  &&  t >= eph->t0  &&  t < eph->t1;
+}
+
+
+// the positions of bodies first .. first+count-1 at time t (ms) into xyz[ 3*count ]:
+// (t must be inside the span -- see EphemerisCovers( ))
+
+void
+EphemerisEvaluate( const Ephemeris *eph, double t, int first, int count, float *xyz )
+{
+	int n = eph->degree + 1;
+	for( int b = first; b < first + count; b++ )
+	{
+		const EphemerisBody *eb = &eph->bodies[b];
+		double u = ( t - eph->t0 ) / eb->segment;
+		int s = (int)u;
+		if( s < 0 )
+			s = 0;
+		if( s > eb->nsegments - 1 )
+			s = eb->nsegments - 1;
+		float x = (float)( 2. * ( u - s ) - 1. );
+
+		const float *c = &eph->coef[ eb->offset + 3 * n * s ];
+		*xyz++ = Clenshaw( c,       eph->degree, x );
+		*xyz++ = Clenshaw( c + n,   eph->degree, x );
+		*xyz++ = Clenshaw( c + 2*n, eph->degree, x );
+	}
+}
+
+
+// the file is the magic number, the counts and the span, each body's
+// segment layout, then all the coefficients as floats, in the byte order
+// of the machine that wrote it:
+
+bool
+EphemerisSave( const Ephemeris *eph, const char *filename )
+{
+	FILE *fp = fopen( filename, "wb" );
+	if( fp == NULL )
+	{
+		fprintf( stderr, "Cannot write ephemeris file '%s'\n", filename );
+		return false;
+	}
+
+	int ncoef = (int)eph->coef.size( );
+	bool ok = fwrite( EPHEMERIS_MAGIC, 1, 4, fp ) == 4
+		&&  fwrite( &eph->nbodies, sizeof(int), 1, fp ) == 1
+		&&  fwrite( &eph->degree, sizeof(int), 1, fp ) == 1
+		&&  fwrite( &eph->t0, sizeof(double), 1, fp ) == 1
+		&&  fwrite( &eph->t1, sizeof(double), 1, fp ) == 1
+		&&  fwrite( &eph->maxError, sizeof(float), 1, fp ) == 1
+		&&  fwrite( &ncoef, sizeof(int), 1, fp ) == 1
+		&&  fwrite( &eph->bodies[0], sizeof(EphemerisBody), eph->nbodies, fp ) == (size_t)eph->nbodies
+		&&  fwrite( &eph->coef[0], sizeof(float), ncoef, fp ) == (size_t)ncoef;
+	fclose( fp );
+	if( ! ok )
+		fprintf( stderr, "Error writing ephemeris file '%s'\n", filename );
+	return ok;
+}
+
+
+// load a file holding exactly nbodies bodies; the counts are checked against
+// the size of the file before anything is allocated:
+
+bool
+EphemerisLoad( Ephemeris *eph, const char *filename, int nbodies )
+{
+	FILE *fp = fopen( filename, "rb" );
+	if( fp == NULL )
+		return false;
+
+	long size = -1;
+	if( fseek( fp, 0, SEEK_END ) == 0 )
+		size = ftell( fp );
+	rewind( fp );
+	const long long header = 4 + 3 * sizeof(int) + 2 * sizeof(double) + sizeof(float);
+
+	char magic[4];
+	int ncoef = 0;
+	bool ok = fread( magic, 1, 4, fp ) == 4  &&  memcmp( magic, EPHEMERIS_MAGIC, 4 ) == 0
+		&&  fread( &eph->nbodies, sizeof(int), 1, fp ) == 1
+		&&  fread( &eph->degree, sizeof(int), 1, fp ) == 1
+		&&  fread( &eph->t0, sizeof(double), 1, fp ) == 1
+		&&  fread( &eph->t1, sizeof(double), 1, fp ) == 1
+		&&  fread( &eph->maxError, sizeof(float), 1, fp ) == 1
+		&&  fread( &ncoef, sizeof(int), 1, fp ) == 1
+		&&  eph->nbodies == nbodies  &&  eph->t1 > eph->t0  &&  eph->degree >= 0  &&  eph->degree <= EPHEMERIS_MAX_DEGREE  &&  ncoef > 0
+		&&  size - header == (long long)( nbodies * sizeof(EphemerisBody) ) + ncoef * (long long)sizeof(float);
+	if( ok )
+	{
+		eph->bodies.resize( eph->nbodies );
+		eph->coef.resize( ncoef );
+		ok = fread( &eph->bodies[0], sizeof(EphemerisBody), eph->nbodies, fp ) == (size_t)eph->nbodies
+			&&  fread( &eph->coef[0], sizeof(float), ncoef, fp ) == (size_t)ncoef;
+	}
+	fclose( fp );
+
+	// every body's segments must lie inside the coefficients that were read:
+
+	for( int b = 0; ok  &&  b < eph->nbodies; b++ )
+	{
+		const EphemerisBody *eb = &eph->bodies[b];
+		ok = eb->nsegments > 0  &&  eb->segment > 0.  &&  eb->offset >= 0
+			&&  eb->offset + 3 * ( eph->degree + 1 ) * (size_t)eb->nsegments <= (size_t)ncoef;
+	}
+	if( ! ok )
+	{
+		fprintf( stderr, "Ephemeris file '%s' is not valid\n", filename );
+		eph->nbodies = 0;
+	}
+	return ok;
+}
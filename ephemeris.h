@@ -0,0 +1,50 @@
+//
+//	Precomputed ephemeris tables: each body's position over a span of time,
+//	fitted with Chebyshev polynomials piecewise over short segments.
+//
+//	Each body gets its own segment length, a fixed fraction of its orbital
+//	period, so a fast inner planet gets many short segments and a slow outer
+//	one a few long ones. Evaluating a position is a segment lookup and a
+//	Clenshaw recurrence per axis -- a couple of dozen multiply-adds, the same
+//	at any time in the span, however far from the start.
+//
+//	The tables can be saved to and loaded from a compact binary file.
+
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <vector>
+
+// highest degree of the Chebyshev polynomials:
+
+const int EPHEMERIS_MAX_DEGREE = { 16 };
+
+struct EphemerisBody
+{
+	double	segment;		// length of each of the body's segments, ms
+	int		nsegments;		// # of segments covering the span
+	int		offset;			// index of the body's first coefficient in Ephemeris::coef
+};
+
+struct Ephemeris
+{
+	int							nbodies;	// # of bodies
+	int							degree;		// degree of the polynomials, degree+1 coefficients each
+	double						t0;			// start of the span, ms
+	double						t1;			// end of the span, ms
+	std::vector<EphemerisBody>	bodies;
+	std::vector<float>			coef;		// per body, per segment, per axis: degree+1 coefficients
+	float						maxError;	// largest error found checking the fit, 0. if not checked
+};
+
+// the position of body i at time t, the model being fitted:
+
+typedef void (*EphemerisSource)( void *, int, double, double [3] );
+
+void	EphemerisFit( Ephemeris *, int, const double *, int, int, double, double, EphemerisSource, void * );
+bool	EphemerisCovers( const Ephemeris *, double );
+void	EphemerisEvaluate( const Ephemeris *, double, int, int, float * );
+bool	EphemerisSave( const Ephemeris *, const char * );
+bool	EphemerisLoad( Ephemeris *, const char *, int );
+
+#endif
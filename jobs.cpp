@@ -0,0 +1,192 @@
+//
+//	The job system -- see jobs.h.
+//
+
+#include <algorithm>
+
+#include "jobs.h"
+
+// which of the system's threads this is, 0 for the one that started it:
+
+static thread_local int JobThreadIndex = 0;
+
+
+// take a job for thread self: its own newest, else another's oldest:
+
+static bool
+TakeJob( JobSystem *js, int self, Job *job )
+{
+	for( int k = 0; k < js->threads; k++ )
+	{
+		int victim = ( self + k ) % js->threads;
+		JobQueue *q = &js->queues[victim];
+		std::lock_guard<std::mutex> guard( q->lock );
+		if( q->jobs.empty( ) )
+			continue;
+		if( k == 0 )
+		{
+			*job = q->jobs.back( );
+			q->jobs.pop_back( );
+		}
+		else
+		{
+			*job = q->jobs.front( );
+			q->jobs.pop_front( );
+			js->stolen++;
+		}
+		js->queued--;
+		return true;
+	}
+	return false;
+}
+
+
+static void
+RunJob( JobSystem *js, Job *job )
+{
+	job->func( job->arg, job->first, job->count, JobThreadIndex );
+	js->run++;
+	job->counter->pending--;
+}
+
+
+static void
+Worker( JobSystem *js, int index )
+{
+	JobThreadIndex = index;
+	for( ; ; )
+	{
+		Job job;
+		if( TakeJob( js, index, &job ) )
+		{
+			RunJob( js, &job );
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( js->sleepLock );
+		while( ! js->quit  &&  js->queued <= 0 )
+			js->wake.wait( lock );
+		if( js->quit )
+			return;
+	}
+}
+
+
+// start threads-1 workers beside the calling thread:
+// (threads <= 0 takes one per core)
+
+void
+JobsInit( JobSystem *js, int threads )
+{
+	if( threads <= 0 )
+		threads = (int)std::thread::hardware_concurrency( );
+	js->threads = std::max( 1, std::min( threads, JOB_MAX_THREADS ) );
+	js->enabled = true;
+	js->queued = 0;
+	js->quit = false;
+	js->run = js->stolen = 0;
+	JobThreadIndex = 0;
+	for( int w = 1; w < js->threads; w++ )
+		js->workers[w] = std::thread( Worker, js, w );
+}
+
+
+// stop and join the workers:
+// (call with no batch in flight)
+
+void
+JobsShutdown( JobSystem *js )
+{
+	{
+		std::lock_guard<std::mutex> guard( js->sleepLock );
+		js->quit = true;
+	}
+	js->wake.notify_all( );
+	for( int w = 1; w < js->threads; w++ )
+		if( js->workers[w].joinable( ) )
+			js->workers[w].join( );
+	js->threads = 1;
+}
+
+
+// the index of the calling thread, for picking its per-thread buffers:
+
+int
+JobsThread( )
+{
+	return JobThreadIndex;
+}
+
+
+// queue func over [ 0, n ) in jobs of grain items, counted by counter:
+
+void
+JobsParallelFor( JobSystem *js, JobCounter *counter, JobFunc func, void *arg, int n, int grain )
+{
+	if( n <= 0 )
+		return;
+	grain = std::max( grain, 1 );
+	int njobs = ( n + grain - 1 ) / grain;
+	counter->pending += njobs;
+
+	JobQueue *q = &js->queues[JobThreadIndex];
+	{
+		std::lock_guard<std::mutex> guard( q->lock );
+		for( int first = 0; first < n; first += grain )
+		{
+			Job job = { func, arg, first, std::min( grain, n - first ), counter };
+			q->jobs.push_back( job );
+		}
+	}
+	js->queued += njobs;
+
+	// taking the lock means no worker is between checking queued and sleeping:
+	{
+		std::lock_guard<std::mutex> guard( js->sleepLock );
+	}
+	js->wake.notify_all( );
+}
+
+
+// run jobs until counter's batch has finished:
+
+void
+JobsWait( JobSystem *js, JobCounter *counter )
+{
+	while( counter->pending > 0 )
+	{
+		Job job;
+		if( TakeJob( js, JobThreadIndex, &job ) )
+			RunJob( js, &job );
+		else
+			std::this_thread::yield( );
+	}
+}
+
+
+// run func over [ 0, n ) in jobs of grain items and wait for them all:
+// (with the system disabled, or on one thread, it is one call on this thread)
+
+void
+JobsRun( JobSystem *js, JobFunc func, void *arg, int n, int grain )
+{
+	if( n <= 0 )
+		return;
+	if( ! js->enabled  ||  js->threads <= 1 )
+	{
+		func( arg, 0, n, JobThreadIndex );
+		return;
+	}
+	JobCounter counter;
+	counter.pending = 0;
+	JobsParallelFor( js, &counter, func, arg, n, grain );
+	JobsWait( js, &counter );
+}
+
+
+void
+JobsResetStats( JobSystem *js )
+{
+	js->run = 0;
+	js->stolen = 0;
+}
@@ -0,0 +1,70 @@
+//
+//	A work-stealing job system.
+//
+//	Worker threads are started once, instead of for every update. Each thread
+//	has its own queue of jobs, the GL thread included as thread 0. A thread
+//	takes its own jobs from the back of its queue, newest first, while their
+//	data is still in its cache. When its queue is empty it steals the oldest
+//	job from the front of another thread's queue. A job is a function run over
+//	a range [ first, first+count ) of a batch. It is passed the index of the
+//	thread running it, so it can fill that thread's own buffers without locks.
+//
+//	A JobCounter counts a batch down to zero as its jobs finish. The thread
+//	that waits on it runs jobs meanwhile, its own or stolen ones, so the GL
+//	thread is never left idle. Jobs may start and wait on batches of their own.
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+const int JOB_MAX_THREADS = { 16 };
+
+typedef void (*JobFunc)( void *, int, int, int );		// arg, first, count, thread
+
+struct JobCounter
+{
+	std::atomic<int>	pending;		// jobs of the batch not yet finished
+};
+
+struct Job
+{
+	JobFunc		func;
+	void		*arg;
+	int			first, count;
+	JobCounter	*counter;
+};
+
+struct JobQueue
+{
+	std::mutex			lock;
+	std::deque<Job>		jobs;			// the owner works at the back, thieves at the front
+};
+
+struct JobSystem
+{
+	int						threads;		// # of threads, the GL thread included
+	bool					enabled;		// false runs every batch on the calling thread, as one range
+	std::thread				workers[JOB_MAX_THREADS];
+	JobQueue				queues[JOB_MAX_THREADS];
+	std::atomic<int>		queued;			// # of jobs in all the queues
+	std::atomic<bool>		quit;
+	std::mutex				sleepLock;		// idle workers sleep on wake
+	std::condition_variable	wake;
+	std::atomic<int>		run;			// # of jobs run since JobsResetStats( )
+	std::atomic<int>		stolen;			// # of them taken from another thread's queue
+};
+
+void	JobsInit( JobSystem *, int );
+void	JobsShutdown( JobSystem * );
+int		JobsThread( );
+void	JobsParallelFor( JobSystem *, JobCounter *, JobFunc, void *, int, int );
+void	JobsWait( JobSystem *, JobCounter * );
+void	JobsRun( JobSystem *, JobFunc, void *, int, int );
+void	JobsResetStats( JobSystem * );
+
+#endif
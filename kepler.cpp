@@ -0,0 +1,314 @@
+//
+//	Keplerian orbit propagation for many bodies at once -- see kepler.h.
+//
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "kepler.h"
+
+// # of Newton iterations of the Kepler solve:
+// (a fixed count keeps the loop branch-free; from Danby's starting guess,
+//  E = M + 0.85 e sign(M), this converges to float precision for e up to 0.99)
+
+const int KEPLER_ITERATIONS = { 6 };
+
+const float  PI_F     = { (float)M_PI };
+const float  HALFPI_F = { (float)( M_PI / 2. ) };
+const float  TWOPI_F  = { (float)( 2. * M_PI ) };
+const double TWOPI    = { 2. * M_PI };
+
+
+// sin( ) of an angle in [ -PI, PI ]:
+// (sin(x) = sign(x) sin( min( |x|, PI-|x| ) ), which puts the argument in
+//  [ 0, PI/2 ] for the Taylor series to x^11, good to about 6.e-8 -- all of it
+//  selects, abs/copysign and arithmetic, so it inlines into the propagation
+//  loops without branches and lets them vectorize)
+
+static inline float
+SinPi( float x )
+{
+	float ax = fabsf( x );
+	float y = ax < PI_F - ax ? ax : PI_F - ax;
+	float y2 = y * y;
+	float sy = y * ( 1.f + y2 * ( -1.f/6.f + y2 * ( 1.f/120.f + y2 * ( -1.f/5040.f
+			+ y2 * ( 1.f/362880.f + y2 * ( -1.f/39916800.f ) ) ) ) ) );
+	return copysignf( sy, x );
+}
+
+
+// wrap an angle into [ -PI, PI ]:
+// (only used on angles a few turns at most from zero)
+
+static inline float
+WrapPi( float x )
+{
+	float k = x * ( 1.f / TWOPI_F );
+	k = (float)(int)( k + copysignf( 0.5f, k ) );
+	return x - k * TWOPI_F;
+}
+
+
+static inline void
+SinCos( float x, float *s, float *c )
+{
+	x = WrapPi( x );
+	*s = SinPi( x );
+	*c = SinPi( WrapPi( x + HALFPI_F ) );
+}
+
+
+void
+KeplerInit( KeplerSet *ks )
+{
+	ks->n = 0;
+	ks->M0.clear( );
+	ks->meanMotion.clear( );
+	ks->a.clear( );
+	ks->e.clear( );
+	ks->b.clear( );
+	ks->px.clear( );	ks->py.clear( );	ks->pz.clear( );
+	ks->qx.clear( );	ks->qy.clear( );	ks->qz.clear( );
+}
+
+
+void
+KeplerReserve( KeplerSet *ks, int n )
+{
+	ks->M0.reserve( n );
+	ks->meanMotion.reserve( n );
+	ks->a.reserve( n );
+	ks->e.reserve( n );
+	ks->b.reserve( n );
+	ks->px.reserve( n );	ks->py.reserve( n );	ks->pz.reserve( n );
+	ks->qx.reserve( n );	ks->qy.reserve( n );	ks->qz.reserve( n );
+}
+
+
+// add a body and return its index:
+//	a		semi-major axis
+//	e		eccentricity
+//	inc		inclination to the ecliptic, degrees
+//	node	longitude of the ascending node, degrees
+//	peri	argument of perihelion, degrees
+//	M0		mean anomaly at t = 0., degrees
+//	period	orbital period, milliseconds of simulation time
+
+int
+KeplerAdd( KeplerSet *ks, float a, float e, float inc, float node, float peri, float M0, float period )
+{
+	const double D2R = M_PI / 180.;
+	double ci = cos( inc * D2R ),	si = sin( inc * D2R );
+	double cn = cos( node * D2R ),	sn = sin( node * D2R );
+	double cw = cos( peri * D2R ),	sw = sin( peri * D2R );
+
+	// the perifocal axes in ecliptic coordinates:
+
+	double P[3] = { cn*cw - sn*sw*ci,	sn*cw + cn*sw*ci,	sw*si };
+	double Q[3] = { -cn*sw - sn*cw*ci,	-sn*sw + cn*cw*ci,	cw*si };
+
+	// ecliptic (x,y,z) is scene (x,z,-y):
+
+	ks->px.push_back( (float)P[0] );	ks->py.push_back( (float)P[2] );	ks->pz.push_back( (float)-P[1] );
+	ks->qx.push_back( (float)Q[0] );	ks->qy.push_back( (float)Q[2] );	ks->qz.push_back( (float)-Q[1] );
+
+	ks->a.push_back( a );
+	ks->e.push_back( e );
+	ks->b.push_back( a * sqrtf( 1.f - e*e ) );
+	ks->M0.push_back( M0 * D2R );
+	ks->meanMotion.push_back( TWOPI / period );
+	return ks->n++;
+}
+
+
+// solve Kepler's equation M = E - e sin(E) for the eccentric anomaly E:
+// (M in [ -PI, PI ])
+
+float
+KeplerSolve( float M, float e )
+{
+	float E = M + copysignf( 0.85f * e, M );
+	for( int it = 0; it < KEPLER_ITERATIONS; it++ )
+	{
+		float s, c;
+		SinCos( E, &s, &c );
+		E -= ( E - e * s - M ) / ( 1.f - e * c );
+	}
+	return E;
+}
+
+
+// the eccentric anomaly's sin and cos for a block of nb <= KEPLER_BLOCK lanes,
+// from each lane's mean anomaly m, radians, and eccentricity e -- the solve
+// shared by the propagation loops:
+// (each step a straight loop over the lanes with no branches, so that it
+//  vectorizes; a solve per lane with the Newton iterations inside does not)
+
+static inline void
+KeplerBlock( const double * __restrict m, const float * __restrict e, int nb,
+	float * __restrict s, float * __restrict c )
+{
+	float M[KEPLER_BLOCK], E[KEPLER_BLOCK];
+
+	// the mean anomaly, reduced to [ -PI, PI ] in double precision
+	// so that large t does not eat the float mantissa:
+	// (the whole turns are taken off with floor( ), which stays a double --
+	//  an int would overflow after 2^31 turns, about 29 hours of the inner
+	//  ring particles at the highest warp -- and can be a single vector
+	//  round with SSE4.1, AVX or NEON)
+
+	for( int j = 0; j < nb; j++ )
+	{
+		double k = floor( m[j] * ( 1. / TWOPI ) );
+		M[j] = WrapPi( (float)( m[j] - k * TWOPI ) );
+	}
+
+	// the starting guess:
+
+	for( int j = 0; j < nb; j++ )
+	{
+		E[j] = M[j] + copysignf( 0.85f * e[j], M[j] );
+	}
+
+	// Newton's method:
+
+	for( int it = 0; it < KEPLER_ITERATIONS; it++ )
+	{
+		for( int j = 0; j < nb; j++ )
+		{
+			float sj, cj;
+			SinCos( E[j], &sj, &cj );
+			E[j] -= ( E[j] - e[j] * sj - M[j] ) / ( 1.f - e[j] * cj );
+		}
+	}
+
+	for( int j = 0; j < nb; j++ )
+	{
+		SinCos( E[j], &s[j], &c[j] );
+	}
+}
+
+
+// the position of a body at eccentric anomaly E:
+// (used to draw the orbit paths)
+
+void
+KeplerPositionAt( const KeplerSet *ks, int i, float E, float xyz[3] )
+{
+	float s, c;
+	SinCos( E, &s, &c );
+	float u = ks->a[i] * ( c - ks->e[i] );
+	float v = ks->b[i] * s;
+	xyz[0] = u * ks->px[i] + v * ks->qx[i];
+	xyz[1] = u * ks->py[i] + v * ks->qy[i];
+	xyz[2] = u * ks->pz[i] + v * ks->qz[i];
+}
+
+
+// compute the positions of bodies first .. first+count-1 at time t (ms)
+// into xyz[ 3*count ]:
+// (the work is done KEPLER_BLOCK bodies at a time in structure-of-arrays
+//  temporaries, each step a straight loop with no branches, and only the
+//  final store is interleaved)
+
+void
+KeplerPropagate( const KeplerSet *ks, double t, int first, int count, float *xyz )
+{
+	double m[KEPLER_BLOCK];
+	float s[KEPLER_BLOCK], c[KEPLER_BLOCK];
+	float X[KEPLER_BLOCK], Y[KEPLER_BLOCK], Z[KEPLER_BLOCK];
+
+	for( int base = 0; base < count; base += KEPLER_BLOCK )
+	{
+		int nb = count - base < KEPLER_BLOCK ? count - base : KEPLER_BLOCK;
+		int k0 = first + base;
+
+		const double * __restrict m0 = &ks->M0[k0];
+		const double * __restrict mm = &ks->meanMotion[k0];
+		const float  * __restrict ee = &ks->e[k0];
+
+		for( int j = 0; j < nb; j++ )
+		{
+			m[j] = m0[j] + mm[j] * t;
+		}
+		KeplerBlock( m, ee, nb, s, c );
+
+		// position = a (cos E - e) P + b sin E Q:
+
+		const float * __restrict aa = &ks->a[k0];
+		const float * __restrict bb = &ks->b[k0];
+		const float * __restrict px = &ks->px[k0];
+		const float * __restrict py = &ks->py[k0];
+		const float * __restrict pz = &ks->pz[k0];
+		const float * __restrict qx = &ks->qx[k0];
+		const float * __restrict qy = &ks->qy[k0];
+		const float * __restrict qz = &ks->qz[k0];
+		for( int j = 0; j < nb; j++ )
+		{
+			float u = aa[j] * ( c[j] - ee[j] );
+			float v = bb[j] * s[j];
+			X[j] = u * px[j] + v * qx[j];
+			Y[j] = u * py[j] + v * qy[j];
+			Z[j] = u * pz[j] + v * qz[j];
+		}
+
+		float *out = &xyz[ 3*base ];
+		for( int j = 0; j < nb; j++ )
+		{
+			out[3*j+0] = X[j];
+			out[3*j+1] = Y[j];
+			out[3*j+2] = Z[j];
+		}
+	}
+}
+
+
+// compute the position of body i at each of times t[0 .. count-1] (ms) into
+// xyz[ 3*count ]:
+// (the same blocked solve as KeplerPropagate( ), vectorized
+//  across the times instead of across the bodies)
+
+void
+KeplerPropagateTimes( const KeplerSet *ks, int i, const double *t, int count, float *xyz )
+{
+	double m[KEPLER_BLOCK];
+	float ee[KEPLER_BLOCK], s[KEPLER_BLOCK], c[KEPLER_BLOCK];
+	float X[KEPLER_BLOCK], Y[KEPLER_BLOCK], Z[KEPLER_BLOCK];
+
+	double m0 = ks->M0[i], mm = ks->meanMotion[i];
+	float e = ks->e[i], a = ks->a[i], b = ks->b[i];
+	float px = ks->px[i], py = ks->py[i], pz = ks->pz[i];
+	float qx = ks->qx[i], qy = ks->qy[i], qz = ks->qz[i];
+
+	for( int j = 0; j < KEPLER_BLOCK; j++ )
+		ee[j] = e;
+
+	for( int base = 0; base < count; base += KEPLER_BLOCK )
+	{
+		int nb = count - base < KEPLER_BLOCK ? count - base : KEPLER_BLOCK;
+		const double * __restrict tt = &t[base];
+
+		for( int j = 0; j < nb; j++ )
+		{
+			m[j] = m0 + mm * tt[j];
+		}
+		KeplerBlock( m, ee, nb, s, c );
+
+		for( int j = 0; j < nb; j++ )
+		{
+			float u = a * ( c[j] - e );
+			float v = b * s[j];
+			X[j] = u * px + v * qx;
+			Y[j] = u * py + v * qy;
+			Z[j] = u * pz + v * qz;
+		}
+
+		float *out = &xyz[ 3*base ];
+		for( int j = 0; j < nb; j++ )
+		{
+			out[3*j+0] = X[j];
+			out[3*j+1] = Y[j];
+			out[3*j+2] = Z[j];
+		}
+	}
+}
@@ -0,0 +1,45 @@
+//
+//	Keplerian orbit propagation for many bodies at once.
+//
+//	The orbital elements are kept as a structure of arrays, and the per-body
+//	constants are folded into two unit vectors when a body is added, so that
+//	propagating is a fixed-iteration Kepler solve and a few multiply-adds
+//	over contiguous floats -- loops the compiler can vectorize.
+//
+//	Positions are in scene coordinates: the ecliptic is the x-z plane and
+//	ecliptic north is +y.
+
+#ifndef KEPLER_H
+#define KEPLER_H
+
+#include <vector>
+
+// # of bodies propagated together through the block-sized temporaries:
+
+const int KEPLER_BLOCK = { 256 };
+
+// the orbits of a set of bodies, one entry per body in each array:
+
+struct KeplerSet
+{
+	int					n;				// # of bodies
+
+	std::vector<double>	M0;				// mean anomaly at t = 0., radians
+	std::vector<double>	meanMotion;		// radians per millisecond of simulation time
+
+	std::vector<float>	a;				// semi-major axis
+	std::vector<float>	e;				// eccentricity, 0. <= e < 1.
+	std::vector<float>	b;				// semi-minor axis, a * sqrt( 1. - e*e )
+	std::vector<float>	px, py, pz;		// unit vector from the focus towards perihelion
+	std::vector<float>	qx, qy, qz;		// unit vector 90 degrees further along the orbit
+};
+
+void	KeplerInit( KeplerSet * );
+void	KeplerReserve( KeplerSet *, int );
+int		KeplerAdd( KeplerSet *, float, float, float, float, float, float, float );
+void	KeplerPropagate( const KeplerSet *, double, int, int, float * );
+void	KeplerPropagateTimes( const KeplerSet *, int, const double *, int, float * );
+void	KeplerPositionAt( const KeplerSet *, int, float, float [3] );
+float	KeplerSolve( float, float );
+
+#endif
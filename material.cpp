@@ -0,0 +1,102 @@
+//
+//	Materials and lights -- see material.h.
+//
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "glew.h"
+
+#include "material.h"
+
+// what the back faces always get:
+
+static const float BACK_AMBIENT[4]  = { .4f, .4f, .4f, 1. };
+static const float BACK_DIFFUSE[4]  = { 1., 1., 1., 1. };
+static const float BACK_SHININESS   = { 5.f };
+static const float BLACK[4]         = { 0., 0., 0., 1. };
+
+
+static void
+Set4( float v[4], float a, float b, float c )
+{
+	v[0] = a;
+	v[1] = b;
+	v[2] = c;
+	v[3] = 1.;
+}
+
+
+// a plain colored material with a white highlight:
+
+Material
+MaterialColored( float r, float g, float b, float shininess )
+{
+	Material mat;
+	Set4( mat.ambient, r, g, b );
+	Set4( mat.diffuse, r, g, b );
+	Set4( mat.specular, .8f, .8f, .8f );
+	Set4( mat.emission, 0., 0., 0. );
+	mat.shininess = shininess;
+	return mat;
+}
+
+
+// a point light of color ( r, g, b ) at ( x, y, z ), unattenuated:
+
+PointLight
+PointLightAt( float x, float y, float z, float r, float g, float b )
+{
+	PointLight light;
+	Set4( light.position, x, y, z );
+	Set4( light.ambient, 0., 0., 0. );
+	Set4( light.diffuse, r, g, b );
+	Set4( light.specular, r, g, b );
+	return light;
+}
+
+
+void
+FrameLightingInit( FrameLighting *fl, const PointLight *sun, float ambient )
+{
+	fl->sun = *sun;
+	Set4( fl->ambient, ambient, ambient, ambient );
+}
+
+
+// make mat the fixed-function front material:
+
+void
+MaterialApply( const Material *mat )
+{
+	glMaterialfv( GL_BACK, GL_EMISSION, BLACK );
+	glMaterialfv( GL_BACK, GL_AMBIENT, BACK_AMBIENT );
+	glMaterialfv( GL_BACK, GL_DIFFUSE, BACK_DIFFUSE );
+	glMaterialfv( GL_BACK, GL_SPECULAR, BLACK );
+	glMaterialf( GL_BACK, GL_SHININESS, BACK_SHININESS );
+
+	glMaterialfv( GL_FRONT, GL_EMISSION, mat->emission );
+	glMaterialfv( GL_FRONT, GL_AMBIENT, mat->ambient );
+	glMaterialfv( GL_FRONT, GL_DIFFUSE, mat->diffuse );
+	glMaterialfv( GL_FRONT, GL_SPECULAR, mat->specular );
+	glMaterialf( GL_FRONT, GL_SHININESS, mat->shininess );
+}
+
+
+// give fixed function the frame's lighting, the Sun as light ilight:
+// (the position goes through the current modelview, as glLightfv( ) does)
+
+void
+LightingApply( const FrameLighting *fl, int ilight )
+{
+	glLightModelfv( GL_LIGHT_MODEL_AMBIENT, fl->ambient );
+	glLightModeli( GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE );
+	glLightfv( ilight, GL_POSITION, fl->sun.position );
+	glLightfv( ilight, GL_AMBIENT, fl->sun.ambient );
+	glLightfv( ilight, GL_DIFFUSE, fl->sun.diffuse );
+	glLightfv( ilight, GL_SPECULAR, fl->sun.specular );
+	glLightf( ilight, GL_CONSTANT_ATTENUATION, 1. );
+	glLightf( ilight, GL_LINEAR_ATTENUATION, 0. );
+	glLightf( ilight, GL_QUADRATIC_ATTENUATION, 0. );
+}
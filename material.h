@@ -0,0 +1,45 @@
+//
+//	Materials and lights as plain values.
+//
+//	A Material or a PointLight is an ordinary struct, built without touching
+//	GL, so it can be made on any thread and copied, compared or put in a
+//	uniform buffer. Only MaterialApply( ) and LightingApply( ) talk to GL,
+//	for the fixed-function path, and only on the thread that owns the context.
+//	The frame's lighting is one FrameLighting block, set up once per frame and
+//	handed over whole: to the per-pixel shaders as one uniform buffer upload,
+//	or to fixed function as one batch of glLight calls.
+
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+struct Material
+{
+	float	ambient[4];
+	float	diffuse[4];
+	float	specular[4];
+	float	emission[4];
+	float	shininess;
+};
+
+struct PointLight
+{
+	float	position[4];		// world coordinates, w = 1.
+	float	ambient[4];
+	float	diffuse[4];
+	float	specular[4];
+};
+
+struct FrameLighting
+{
+	PointLight	sun;
+	float		ambient[4];		// the light model's global ambient
+};
+
+Material	MaterialColored( float, float, float, float );
+PointLight	PointLightAt( float, float, float, float, float, float );
+void		FrameLightingInit( FrameLighting *, const PointLight *, float );
+
+void		MaterialApply( const Material * );
+void		LightingApply( const FrameLighting *, int );
+
+#endif
@@ -0,0 +1,466 @@
+//
+//	N-body gravity -- see nbody.h.
+//
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "nbody.h"
+
+// the most threads the force walks are split across:
+
+const int NBODY_MAX_THREADS = { 16 };
+
+// below this many bodies per thread, the walks are not worth a thread:
+
+const int NBODY_MIN_PER_THREAD = { 512 };
+
+
+static double
+NBodyNowMs( )
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>( steady_clock::now( ).time_since_epoch( ) ).count( );
+}
+
+
+// run fn( ns, first, count ) over bodies 0 .. n-1, one contiguous range per thread:
+
+template <class Fn>
+static void
+NBodyParallel( NBodySystem *ns, int n, Fn fn )
+{
+	int nt = std::max( 1, std::min( ns->threads, n / NBODY_MIN_PER_THREAD ) );
+	int chunk = ( n + nt - 1 ) / nt;
+
+	std::thread workers[NBODY_MAX_THREADS];
+	int nworkers = 0;
+	for( int first = chunk; first < n; first += chunk )
+		workers[nworkers++] = std::thread( fn, ns, first, std::min( chunk, n - first ) );
+	fn( ns, 0, std::min( chunk, n ) );
+	for( int w = 0; w < nworkers; w++ )
+		workers[w].join( );
+}
+
+
+//	G			gravitational constant, in whatever units the caller's positions,
+//				velocities, masses and times are in
+//	softening	added in quadrature to every distance, so close encounters stay finite
+//	theta		Barnes-Hut opening angle: 0. is exact, 0.5 is the usual compromise
+
+void
+NBodyInit( NBodySystem *ns, double G, double softening, double theta )
+{
+	ns->n = 0;
+	ns->x.clear( );		ns->y.clear( );		ns->z.clear( );
+	ns->vx.clear( );	ns->vy.clear( );	ns->vz.clear( );
+	ns->ax.clear( );	ns->ay.clear( );	ns->az.clear( );
+	ns->m.clear( );
+	ns->nodes.clear( );
+	ns->next.clear( );
+
+	ns->G = G;
+	ns->softening = softening;
+	ns->theta = theta;
+	ns->threads = std::max( 1, std::min( (int)std::thread::hardware_concurrency( ), NBODY_MAX_THREADS ) );
+	ns->buildMs = ns->forceMs = 0.;
+}
+
+
+// add a body and return its index:
+// (call NBodyComputeForces( ) once after the last one, before the first step)
+
+int
+NBodyAdd( NBodySystem *ns, double m, double x, double y, double z, double vx, double vy, double vz )
+{
+	ns->x.push_back( x );	ns->y.push_back( y );	ns->z.push_back( z );
+	ns->vx.push_back( vx );	ns->vy.push_back( vy );	ns->vz.push_back( vz );
+	ns->ax.push_back( 0. );	ns->ay.push_back( 0. );	ns->az.push_back( 0. );
+	ns->m.push_back( m );
+	ns->next.push_back( -1 );
+	return ns->n++;
+}
+
+
+static inline int
+Octant( const OctNode *nd, double x, double y, double z )
+{
+	return ( x > nd->cx ? 1 : 0 ) | ( y > nd->cy ? 2 : 0 ) | ( z > nd->cz ? 4 : 0 );
+}
+
+
+// drop body i into the tree, splitting leaves on the way down:
+
+static void
+TreeInsert( NBodySystem *ns, int i )
+{
+	double x = ns->x[i], y = ns->y[i], z = ns->z[i];
+	int node = 0;
+	for( int depth = 0; ; depth++ )
+	{
+		OctNode *nd = &ns->nodes[node];
+		if( nd->child < 0 )
+		{
+			if( nd->body < 0 )
+			{
+				nd->body = i;
+				ns->next[i] = -1;
+				return;
+			}
+			if( depth >= NBODY_MAX_DEPTH )
+			{
+				ns->next[i] = nd->body;
+				nd->body = i;
+				return;
+			}
+
+			// split the leaf and move its body down into one of the children:
+
+			int j = nd->body;
+			int first = (int)ns->nodes.size( );
+			OctNode parent = *nd;
+			ns->nodes.resize( first + 8 );		// (invalidates nd)
+			double h = parent.half / 2.;
+			for( int k = 0; k < 8; k++ )
+			{
+				OctNode *c = &ns->nodes[first + k];
+				c->cx = parent.cx + ( k & 1 ? h : -h );
+				c->cy = parent.cy + ( k & 2 ? h : -h );
+				c->cz = parent.cz + ( k & 4 ? h : -h );
+				c->half = h;
+				c->child = c->body = -1;
+			}
+			ns->nodes[node].child = first;
+			ns->nodes[node].body = -1;
+			ns->nodes[ first + Octant( &parent, ns->x[j], ns->y[j], ns->z[j] ) ].body = j;
+			nd = &ns->nodes[node];
+		}
+		node = nd->child + Octant( nd, x, y, z );
+	}
+}
+
+
+// build the octree over all the bodies and fill in each cell's mass and center of mass:
+
+static void
+TreeBuild( NBodySystem *ns )
+{
+	int n = ns->n;
+	double lo[3] = { ns->x[0], ns->y[0], ns->z[0] };
+	double hi[3] = { lo[0], lo[1], lo[2] };
+	for( int i = 1; i < n; i++ )
+	{
+		lo[0] = std::min( lo[0], ns->x[i] );	hi[0] = std::max( hi[0], ns->x[i] );
+		lo[1] = std::min( lo[1], ns->y[i] );	hi[1] = std::max( hi[1], ns->y[i] );
+		lo[2] = std::min( lo[2], ns->z[i] );	hi[2] = std::max( hi[2], ns->z[i] );
+	}
+
+	ns->nodes.clear( );
+	ns->nodes.reserve( 2 * (size_t)n + 8 );
+	OctNode root;
+	root.cx = ( lo[0] + hi[0] ) / 2.;
+	root.cy = ( lo[1] + hi[1] ) / 2.;
+	root.cz = ( lo[2] + hi[2] ) / 2.;
+	root.half = 0.5 * std::max( hi[0] - lo[0], std::max( hi[1] - lo[1], hi[2] - lo[2] ) ) * 1.0001 + 1.e-9;
+	root.child = root.body = -1;
+	ns->nodes.push_back( root );
+
+	for( int i = 0; i < n; i++ )
+		TreeInsert( ns, i );
+
+	// children are always created after their parent, so walking the array
+	// backwards visits every child before the cell that holds it:
+
+	for( int k = (int)ns->nodes.size( ) - 1; k >= 0; k-- )
+	{
+		OctNode *nd = &ns->nodes[k];
+		double mass = 0., mx = 0., my = 0., mz = 0.;
+		if( nd->child < 0 )
+		{
+			for( int b = nd->body; b >= 0; b = ns->next[b] )
+			{
+				mass += ns->m[b];
+				mx += ns->m[b] * ns->x[b];
+				my += ns->m[b] * ns->y[b];
+				mz += ns->m[b] * ns->z[b];
+			}
+		}
+		else
+		{
+			for( int c = 0; c < 8; c++ )
+			{
+				const OctNode *ch = &ns->nodes[nd->child + c];
+				mass += ch->mass;
+				mx += ch->mass * ch->mx;
+				my += ch->mass * ch->my;
+				mz += ch->mass * ch->mz;
+			}
+		}
+		nd->mass = mass;
+		if( mass > 0. )
+		{
+			nd->mx = mx / mass;
+			nd->my = my / mass;
+			nd->mz = mz / mass;
+		}
+		else
+		{
+			nd->mx = nd->cx;
+			nd->my = nd->cy;
+			nd->mz = nd->cz;
+		}
+	}
+}
+
+
+// walk the tree for body i and return the acceleration and potential there:
+// (a cell is taken as a point mass when its width is under theta times the
+//  distance to its center of mass and the body is not inside it)
+
+static void
+TreeWalk( const NBodySystem *ns, int i, double acc[3], double *phi )
+{
+	double x = ns->x[i], y = ns->y[i], z = ns->z[i];
+	double eps2 = ns->softening * ns->softening;
+	double theta2 = ns->theta * ns->theta;
+	double ax = 0., ay = 0., az = 0., pot = 0.;
+
+	int stack[ 8 * NBODY_MAX_DEPTH + 8 ];
+	int sp = 0;
+	stack[sp++] = 0;
+	while( sp > 0 )
+	{
+		const OctNode *nd = &ns->nodes[ stack[--sp] ];
+		if( nd->mass <= 0. )
+			continue;
+
+		if( nd->child < 0 )
+		{
+			for( int b = nd->body; b >= 0; b = ns->next[b] )
+			{
+				if( b == i )
+					continue;
+				double dx = ns->x[b] - x, dy = ns->y[b] - y, dz = ns->z[b] - z;
+				double r2 = dx*dx + dy*dy + dz*dz + eps2;
+				double rinv = 1. / sqrt( r2 );
+				double mr3 = ns->m[b] * rinv * rinv * rinv;
+				ax += mr3 * dx;		ay += mr3 * dy;		az += mr3 * dz;
+				pot -= ns->m[b] * rinv;
+			}
+			continue;
+		}
+
+		double dx = nd->mx - x, dy = nd->my - y, dz = nd->mz - z;
+		double d2 = dx*dx + dy*dy + dz*dz;
+		double w = 2. * nd->half;
+		bool inside = fabs( x - nd->cx ) <= nd->half  &&  fabs( y - nd->cy ) <= nd->half  &&  fabs( z - nd->cz ) <= nd->half;
+		if( !inside  &&  w*w < theta2 * d2 )
+		{
+			double r2 = d2 + eps2;
+			double rinv = 1. / sqrt( r2 );
+			double mr3 = nd->mass * rinv * rinv * rinv;
+			ax += mr3 * dx;		ay += mr3 * dy;		az += mr3 * dz;
+			pot -= nd->mass * rinv;
+		}
+		else
+		{
+			for( int c = 0; c < 8; c++ )
+				stack[sp++] = nd->child + c;
+		}
+	}
+
+	acc[0] = ns->G * ax;
+	acc[1] = ns->G * ay;
+	acc[2] = ns->G * az;
+	*phi = ns->G * pot;
+}
+
+
+static void
+ForceRange( NBodySystem *ns, int first, int count )
+{
+	for( int i = first; i < first + count; i++ )
+	{
+		double acc[3], phi;
+		TreeWalk( ns, i, acc, &phi );
+		ns->ax[i] = acc[0];
+		ns->ay[i] = acc[1];
+		ns->az[i] = acc[2];
+	}
+}
+
+
+// fill ax, ay, az for the current positions:
+
+void
+NBodyComputeForces( NBodySystem *ns )
+{
+	if( ns->n == 0 )
+		return;
+
+	double start = NBodyNowMs( );
+	TreeBuild( ns );
+	double built = NBodyNowMs( );
+	NBodyParallel( ns, ns->n, ForceRange );
+	ns->buildMs = built - start;
+	ns->forceMs = NBodyNowMs( ) - built;
+}
+
+
+// advance by dt with one kick-drift-kick leapfrog step:
+// (symplectic, so the energy error stays bounded over many orbits instead of
+//  drifting -- the accelerations from the end of the last step are reused)
+
+void
+NBodyStep( NBodySystem *ns, double dt )
+{
+	int n = ns->n;
+	double h = dt / 2.;
+	for( int i = 0; i < n; i++ )
+	{
+		ns->vx[i] += h * ns->ax[i];
+		ns->vy[i] += h * ns->ay[i];
+		ns->vz[i] += h * ns->az[i];
+		ns->x[i] += dt * ns->vx[i];
+		ns->y[i] += dt * ns->vy[i];
+		ns->z[i] += dt * ns->vz[i];
+	}
+
+	NBodyComputeForces( ns );
+
+	for( int i = 0; i < n; i++ )
+	{
+		ns->vx[i] += h * ns->ax[i];
+		ns->vy[i] += h * ns->ay[i];
+		ns->vz[i] += h * ns->az[i];
+	}
+}
+
+
+// the potential energy of bodies first .. first+count-1, summed over every
+// other body (exact) or through the tree (approximate), into pe[ ]:
+
+static std::vector<double> PartialEnergy;
+
+static void
+ExactPotentialRange( NBodySystem *ns, int first, int count )
+{
+	double eps2 = ns->softening * ns->softening;
+	double sum = 0.;
+	for( int i = first; i < first + count; i++ )
+	{
+		for( int j = i + 1; j < ns->n; j++ )
+		{
+			double dx = ns->x[j] - ns->x[i], dy = ns->y[j] - ns->y[i], dz = ns->z[j] - ns->z[i];
+			sum -= ns->m[i] * ns->m[j] / sqrt( dx*dx + dy*dy + dz*dz + eps2 );
+		}
+	}
+	PartialEnergy[ first ] = ns->G * sum;
+}
+
+
+static void
+TreePotentialRange( NBodySystem *ns, int first, int count )
+{
+	double sum = 0.;
+	for( int i = first; i < first + count; i++ )
+	{
+		double acc[3], phi;
+		TreeWalk( ns, i, acc, &phi );
+		sum += 0.5 * ns->m[i] * phi;
+	}
+	PartialEnergy[ first ] = sum;
+}
+
+
+// the total energy, kinetic plus potential:
+// (the potential is exact up to NBODY_EXACT_ENERGY bodies and goes through
+//  the tree above that, so compare drifts at the same body count)
+
+double
+NBodyEnergy( NBodySystem *ns )
+{
+	int n = ns->n;
+	double kinetic = 0.;
+	for( int i = 0; i < n; i++ )
+		kinetic += 0.5 * ns->m[i] * ( ns->vx[i]*ns->vx[i] + ns->vy[i]*ns->vy[i] + ns->vz[i]*ns->vz[i] );
+
+	PartialEnergy.assign( n, 0. );
+	if( n <= NBODY_EXACT_ENERGY )
+	{
+		NBodyParallel( ns, n, ExactPotentialRange );
+	}
+	else
+	{
+		TreeBuild( ns );
+		NBodyParallel( ns, n, TreePotentialRange );
+	}
+
+	double potential = 0.;
+	for( int i = 0; i < n; i++ )
+		potential += PartialEnergy[i];
+	return kinetic + potential;
+}
+
+
+// the scaling benchmark -- no window, just the integrator:
+// a unit central mass with a thin disk of light bodies on circular orbits,
+// from 10 bodies up to maxBodies in factors of 10, timing the tree build and
+// the force walks and measuring the energy drift over the steps
+
+void
+NBodyBenchmark( int maxBodies, int steps )
+{
+	const double G = 1.;
+	const double DT = 0.01;			// about 1/600 of an orbit at the inner edge
+	printf( "nbody: up to %d bodies, %d steps each, %d threads\n", maxBodies, steps,
+		std::max( 1, std::min( (int)std::thread::hardware_concurrency( ), NBODY_MAX_THREADS ) ) );
+	printf( "\t%8s  %6s  %10s  %10s  %10s  %12s\n", "bodies", "steps", "build ms", "force ms", "step ms", "dE/E" );
+
+	// tenfold, but with the last pass maxBodies itself:
+	for( int n = 10; n <= maxBodies; n = n > maxBodies / 10 ? maxBodies : n * 10 )
+	{
+		NBodySystem ns;
+		NBodyInit( &ns, G, 1.e-4, 0.5 );
+		NBodyAdd( &ns, 1., 0., 0., 0., 0., 0., 0. );
+
+		unsigned int state = 12345;
+		for( int i = 1; i < n; i++ )
+		{
+			state ^= state << 13;	state ^= state >> 17;	state ^= state << 5;
+			double u = (double)( state >> 8 ) / (double)( 1 << 24 );
+			state ^= state << 13;	state ^= state >> 17;	state ^= state << 5;
+			double ang = 2. * M_PI * (double)( state >> 8 ) / (double)( 1 << 24 );
+			double r = 1. + 4. * u;
+			double v = sqrt( G / r );
+			NBodyAdd( &ns, 1.e-7 / n, r * cos( ang ), 0.01 * r * ( u - 0.5 ), r * sin( ang ),
+				-v * sin( ang ), 0., v * cos( ang ) );
+		}
+		NBodyComputeForces( &ns );
+		double e0 = NBodyEnergy( &ns );
+
+		// fewer steps for the big systems, so the whole run stays a few minutes:
+		int nsteps = std::max( 1, std::min( steps, (int)( 1.e6 * steps / ( (double)n * 100. ) ) ) );
+		double build = 0., force = 0.;
+		double start = NBodyNowMs( );
+		for( int s = 0; s < nsteps; s++ )
+		{
+			NBodyStep( &ns, DT );
+			build += ns.buildMs;
+			force += ns.forceMs;
+		}
+		double total = NBodyNowMs( ) - start;
+		double e1 = NBodyEnergy( &ns );
+
+		printf( "\t%8d  %6d  %10.3f  %10.3f  %10.3f  %12.3e\n",
+			n, nsteps, build / nsteps, force / nsteps, total / nsteps, ( e1 - e0 ) / fabs( e0 ) );
+		if( n == maxBodies )
+			break;
+	}
+}
@@ -0,0 +1,64 @@
+//
+//	N-body gravity: a kick-drift-kick leapfrog integrator with Barnes-Hut
+//	force evaluation.
+//
+//	Each step builds an octree over the bodies, sums each cell's mass and
+//	center of mass, and walks the tree once per body, treating any cell that
+//	looks smaller than theta radians from the body as a single point mass.
+//	The walks are split across threads. Positions and velocities are kept in
+//	double precision, as structures of arrays.
+
+#ifndef NBODY_H
+#define NBODY_H
+
+#include <vector>
+
+// deepest the octree subdivides -- bodies that still share a cell here
+// are chained together in one leaf:
+
+const int NBODY_MAX_DEPTH = { 48 };
+
+// up to this many bodies, NBodyEnergy( ) sums the potential over every pair:
+// (a few million pairs at most, so the periodic drift check in gravity mode
+//  does not hitch; bigger swarms go through the tree)
+
+const int NBODY_EXACT_ENERGY = { 2000 };
+
+struct OctNode
+{
+	double	cx, cy, cz;		// center of the cell
+	double	half;			// half the width of the cell
+	double	mass;			// total mass in the cell
+	double	mx, my, mz;		// its center of mass
+	int		child;			// index of the first of 8 children, -1 for a leaf
+	int		body;			// first body in a leaf, -1 if empty -- the rest follow next[ ]
+};
+
+struct NBodySystem
+{
+	int					n;					// # of bodies
+	std::vector<double>	x, y, z;			// positions
+	std::vector<double>	vx, vy, vz;			// velocities
+	std::vector<double>	ax, ay, az;			// accelerations at the current positions
+	std::vector<double>	m;					// masses
+
+	double				G;					// gravitational constant, in the caller's units
+	double				softening;			// added in quadrature to every distance
+	double				theta;				// Barnes-Hut opening angle, radians
+	int					threads;			// # of threads the force walks are split across
+
+	std::vector<OctNode> nodes;				// the octree, nodes[0] is the root
+	std::vector<int>	next;				// next body in the same leaf, -1 at the end
+
+	double				buildMs;			// how long the last tree build took
+	double				forceMs;			// how long the last force evaluation took
+};
+
+void	NBodyInit( NBodySystem *, double, double, double );
+int		NBodyAdd( NBodySystem *, double, double, double, double, double, double, double );
+void	NBodyComputeForces( NBodySystem * );
+void	NBodyStep( NBodySystem *, double );
+double	NBodyEnergy( NBodySystem * );
+void	NBodyBenchmark( int, int );
+
+#endif
@@ -0,0 +1,376 @@
+//
+//	The render queue -- see renderqueue.h.
+//
+
+#include <string.h>
+#include <algorithm>
+
+#include "renderqueue.h"
+
+// # of glMaterial calls it takes to set a material, as MaterialApply( ) does:
+
+const int MATERIAL_CALLS = { 10 };
+
+
+void
+RenderInit( RenderQueue *rq )
+{
+	rq->materials.clear( );
+	rq->buffers.clear( );
+	rq->items.clear( );
+	rq->models.clear( );
+	rq->modelViews.clear( );
+	Mat4Identity( &rq->view );
+	rq->shading = NULL;
+	rq->cache.filter = true;
+	rq->cache.requested = rq->cache.issued = 0;
+	rq->drawCalls = rq->vertices = rq->culled = rq->occluded = 0;
+	rq->translucent = 0;
+}
+
+
+// draw layer's items blended, farthest first, instead of in state order:
+
+void
+RenderTranslucent( RenderQueue *rq, int layer )
+{
+	rq->translucent |= 1u << layer;
+}
+
+
+// add a material and return its index, for RenderSubmit( ):
+
+int
+RenderAddMaterial( RenderQueue *rq, const Material *mat )
+{
+	rq->materials.push_back( *mat );
+	return (int)rq->materials.size( ) - 1;
+}
+
+
+// forget whatever GL state is left from before:
+// (everything drawn outside the queue may have changed it)
+
+static void
+Invalidate( RenderCache *rc )
+{
+	rc->texturing = -1;
+	rc->texture = 0xffffffff;
+	rc->lighting = -1;
+	rc->shadeModel = -1;
+	rc->material = -1;
+	rc->program = -1;
+	rc->body = -1;
+}
+
+
+// start a frame's items, lit per-pixel with shading if that is not NULL,
+// with a buffer for each of nthreads threads to submit into:
+
+void
+RenderBegin( RenderQueue *rq, Shading *shading, int nthreads )
+{
+	rq->buffers.resize( nthreads );
+	for( int b = 0; b < nthreads; b++ )
+	{
+		rq->buffers[b].items.clear( );
+		rq->buffers[b].models.clear( );
+		rq->buffers[b].culled = 0;
+		rq->buffers[b].occluded = 0;
+	}
+	rq->items.clear( );
+	rq->models.clear( );
+	rq->shading = shading;
+	rq->cache.requested = rq->cache.issued = 0;
+	rq->drawCalls = rq->vertices = rq->culled = rq->occluded = 0;
+	Invalidate( &rq->cache );
+}
+
+
+void
+RenderSubmit( RenderBuffer *rb, int layer, GLuint list, int vertices, GLuint texture, bool lit, int material,
+		int body, const Mat4 *model )
+{
+	RenderItem item;
+	item.layer = layer;
+	item.list = list;
+	item.vertices = vertices;
+	item.texture = texture;
+	item.lit = lit;
+	item.material = material;
+	item.body = body;
+	item.transform = (int)rb->models.size( );
+	rb->models.push_back( *model );
+
+	// the layer, then what is dearest to change -- lighting and textures --
+	// then materials and per-pixel blocks:
+	item.key = (unsigned long long)( layer & 0xff ) << 56
+		 | (unsigned long long)( lit ? 1 : 0 ) << 48
+		 | (unsigned long long)( texture & 0xffff ) << 32
+		 | (unsigned long long)( material & 0xffff ) << 16
+		 | (unsigned long long)( body & 0xffff );
+	rb->items.push_back( item );
+}
+
+
+static bool
+KeyLess( const RenderItem &a, const RenderItem &b )
+{
+	return a.key < b.key;
+}
+
+
+// gather the threads' buffers, in thread order, and sort them:
+
+void
+RenderSort( RenderQueue *rq )
+{
+	for( size_t b = 0; b < rq->buffers.size( ); b++ )
+	{
+		RenderBuffer *rb = &rq->buffers[b];
+		int base = (int)rq->models.size( );
+		for( size_t i = 0; i < rb->items.size( ); i++ )
+		{
+			rq->items.push_back( rb->items[i] );
+			rq->items.back( ).transform += base;
+		}
+		rq->models.insert( rq->models.end( ), rb->models.begin( ), rb->models.end( ) );
+		rq->culled += rb->culled;
+		rq->occluded += rb->occluded;
+	}
+	std::stable_sort( rq->items.begin( ), rq->items.end( ), KeyLess );
+}
+
+
+// a float's bits, made to compare as unsigned ints in the float's order:
+
+static unsigned int
+SortableFloat( float f )
+{
+	unsigned int bits;
+	memcpy( &bits, &f, sizeof(bits) );
+	return ( bits & 0x80000000u ) != 0 ? ~bits : bits | 0x80000000u;
+}
+
+
+// order the translucent layers' items farthest first, by their origins' z
+// in eye coordinates -- most negative furthest off -- with a least
+// significant digit radix sort, a byte at a time:
+
+static void
+SortBackToFront( RenderQueue *rq )
+{
+	rq->backToFront.clear( );
+	rq->depthKeys.clear( );
+	for( size_t i = 0; i < rq->items.size( ); i++ )
+	{
+		const RenderItem *item = &rq->items[i];
+		if( ( rq->translucent & ( 1u << item->layer ) ) == 0 )
+			continue;
+		rq->depthKeys.push_back( SortableFloat( rq->modelViews[item->transform].m[14] ) );
+		rq->backToFront.push_back( (int)i );
+	}
+
+	size_t n = rq->backToFront.size( );
+	rq->sortKeys.resize( n );
+	rq->sortItems.resize( n );
+	for( int shift = 0; shift < 32; shift += 8 )
+	{
+		size_t start[257] = { 0 };
+		for( size_t k = 0; k < n; k++ )
+			start[ ( ( rq->depthKeys[k] >> shift ) & 0xff ) + 1 ]++;
+		for( int d = 0; d < 256; d++ )
+			start[d+1] += start[d];
+		for( size_t k = 0; k < n; k++ )
+		{
+			size_t to = start[ ( rq->depthKeys[k] >> shift ) & 0xff ]++;
+			rq->sortKeys[to] = rq->depthKeys[k];
+			rq->sortItems[to] = rq->backToFront[k];
+		}
+		rq->depthKeys.swap( rq->sortKeys );
+		rq->backToFront.swap( rq->sortItems );
+	}
+}
+
+
+// every item's model-view, view * model, in one batch, then the
+// translucent items in depth order:
+// (the items point at theirs by index, so sorting does not move them)
+
+void
+RenderTransform( RenderQueue *rq, const Mat4 *view )
+{
+	rq->view = *view;
+	rq->modelViews.resize( rq->models.size( ) );
+	if( ! rq->models.empty( ) )
+		Mat4MultiplyBatch( view, &rq->models[0], &rq->modelViews[0], (int)rq->models.size( ) );
+	SortBackToFront( rq );
+}
+
+
+///// the state cache:
+// each Set function counts the call as requested, and sends it only when
+// it changes what GL has or the cache is not filtering
+
+static bool
+Needed( RenderCache *rc, bool same, int calls )
+{
+	rc->requested += calls;
+	if( rc->filter  &&  same )
+		return false;
+	rc->issued += calls;
+	return true;
+}
+
+
+static void
+SetTexturing( RenderCache *rc, bool on )
+{
+	if( ! Needed( rc, rc->texturing == ( on ? 1 : 0 ), 1 ) )
+		return;
+	if( on )
+		glEnable( GL_TEXTURE_2D );
+	else
+		glDisable( GL_TEXTURE_2D );
+	rc->texturing = on ? 1 : 0;
+}
+
+
+static void
+SetTexture( RenderCache *rc, GLuint texture )
+{
+	if( ! Needed( rc, rc->texture == texture, 1 ) )
+		return;
+	glBindTexture( GL_TEXTURE_2D, texture );
+	rc->texture = texture;
+}
+
+
+static void
+SetLighting( RenderCache *rc, bool on )
+{
+	if( ! Needed( rc, rc->lighting == ( on ? 1 : 0 ), 1 ) )
+		return;
+	if( on )
+		glEnable( GL_LIGHTING );
+	else
+		glDisable( GL_LIGHTING );
+	rc->lighting = on ? 1 : 0;
+}
+
+
+static void
+SetShadeModel( RenderCache *rc, int model )
+{
+	if( ! Needed( rc, rc->shadeModel == model, 1 ) )
+		return;
+	glShadeModel( (GLenum)model );
+	rc->shadeModel = model;
+}
+
+
+static void
+SetRenderMaterial( RenderQueue *rq, int material )
+{
+	RenderCache *rc = &rq->cache;
+	if( ! Needed( rc, rc->material == material, MATERIAL_CALLS ) )
+		return;
+	MaterialApply( &rq->materials[material] );
+	rc->material = material;
+}
+
+
+static void
+SetProgram( RenderQueue *rq, bool on )
+{
+	RenderCache *rc = &rq->cache;
+	if( ! Needed( rc, rc->program == ( on ? 1 : 0 ), 1 ) )
+		return;
+	if( on )
+		ShadingUse( rq->shading );
+	else
+		glUseProgram( 0 );
+	rc->program = on ? 1 : 0;
+}
+
+
+static void
+SetBody( RenderQueue *rq, int body )
+{
+	RenderCache *rc = &rq->cache;
+	if( ! Needed( rc, rc->body == body, 1 ) )
+		return;
+	ShadingBindBody( rq->shading, body );
+	rc->body = body;
+}
+
+
+static void
+DrawItem( RenderQueue *rq, const RenderItem *item )
+{
+	RenderCache *rc = &rq->cache;
+	SetShadeModel( rc, GL_SMOOTH );
+	SetLighting( rc, item->lit );
+	SetTexturing( rc, item->texture != 0 );
+	if( item->texture != 0 )
+		SetTexture( rc, item->texture );
+	if( rq->shading != NULL  &&  item->body >= 0 )
+	{
+		// the material is in the body's uniform block:
+		SetProgram( rq, true );
+		SetBody( rq, item->body );
+	}
+	else
+	{
+		if( rq->shading != NULL )
+			SetProgram( rq, false );
+		SetRenderMaterial( rq, item->material );
+	}
+
+	glLoadMatrixf( rq->modelViews[item->transform].m );
+	glCallList( item->list );
+	rq->drawCalls++;
+	rq->vertices += item->vertices;
+}
+
+
+// draw the items of one layer, in key order -- back to front, blended, for
+// a translucent one -- then leave GL as the code around the queue expects
+// it: lighting on, texturing and the program off, and the modelview the view
+
+void
+RenderDraw( RenderQueue *rq, int layer )
+{
+	RenderCache *rc = &rq->cache;
+	Invalidate( rc );
+
+	if( ( rq->translucent & ( 1u << layer ) ) != 0 )
+	{
+		glEnable( GL_BLEND );
+		glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+		glDepthMask( GL_FALSE );
+		for( size_t k = 0; k < rq->backToFront.size( ); k++ )
+		{
+			const RenderItem *item = &rq->items[ rq->backToFront[k] ];
+			if( item->layer == layer )
+				DrawItem( rq, item );
+		}
+		glDepthMask( GL_TRUE );
+		glDisable( GL_BLEND );
+	}
+	else
+	{
+		for( size_t i = 0; i < rq->items.size( ); i++ )
+		{
+			const RenderItem *item = &rq->items[i];
+			if( item->layer == layer )
+				DrawItem( rq, item );
+		}
+	}
+
+	SetTexturing( rc, false );
+	if( rq->shading != NULL )
+		SetProgram( rq, false );
+	SetLighting( rc, true );
+	glLoadMatrixf( rq->view.m );
+}
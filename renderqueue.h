@@ -0,0 +1,106 @@
+//
+//	A render queue for the frame's bodies.
+//
+//	Display( ) no longer sets up and draws each body in turn. It submits one
+//	item per body, holding its display list, its transform and the state it
+//	needs: texture, lighting, material and per-pixel lighting block. That
+//	state is packed into a sort key. The items are sorted so that those
+//	sharing state come together, then drawn through a cache of the current
+//	GL state. The cache drops every call that would set what is already set.
+//	It counts both the state calls the items asked for and the ones that
+//	actually reached GL.
+//
+//	The items' model matrices are kept apart from them, in one array that
+//	RenderTransform( ) multiplies by the camera's view in a single batch.
+//	Each item is drawn with its model-view loaded whole by glLoadMatrixf( ),
+//	with no push, multiply and pop on the GL matrix stack.
+//
+//	Items can be built on any thread. Each thread submits into its own
+//	RenderBuffer, with no locks, and RenderSort( ) gathers the buffers on the
+//	GL thread. Only RenderDraw( ) talks to GL.
+//
+//	Layers can be marked translucent. Their items are not drawn in state
+//	order but back to front, blended, without writing depth. Once the
+//	model-views are known, RenderTransform( ) orders them by their depth in
+//	front of the eye. It uses a radix sort on the depths' bits, whose cost
+//	depends only on how many items there are, not on how they are ordered.
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <vector>
+
+#include "scenegraph.h"
+#include "shading.h"
+#include "material.h"
+
+struct RenderItem
+{
+	unsigned long long	key;		// layer, lighting, texture, material and body, most significant first
+	int		layer;					// items are drawn a layer at a time, so the passes keep their order
+	GLuint	list;					// display list to call
+	int		vertices;				// # of vertices in it
+	GLuint	texture;				// 2D texture, 0 for none
+	bool	lit;					// false draws with GL_LIGHTING off
+	int		material;				// index into the queue's materials
+	int		body;					// per-pixel lighting block, -1 for none
+	int		transform;				// index into the queue's models and modelViews
+};
+
+// one thread's items, their transforms indexing its own models:
+
+struct RenderBuffer
+{
+	std::vector<RenderItem>		items;
+	std::vector<Mat4>			models;
+	int							culled;			// # of items left out as outside the view
+	int							occluded;		// # left out as hidden behind the Sun or a planet
+};
+
+// what the cache believes GL has, -1 (or 0xffffffff) where it does not know:
+
+struct RenderCache
+{
+	bool	filter;				// false sends every call, as drawing each body in turn did
+	int		texturing;			// GL_TEXTURE_2D enabled
+	GLuint	texture;			// bound 2D texture
+	int		lighting;			// GL_LIGHTING enabled
+	int		shadeModel;
+	int		material;
+	int		program;			// 1 when the lighting program is in use
+	int		body;				// bound per-pixel lighting block
+	int		requested;			// state calls asked for this frame
+	int		issued;				// the ones that were sent to GL
+};
+
+struct RenderQueue
+{
+	std::vector<Material>		materials;
+	std::vector<RenderBuffer>	buffers;		// one per thread, gathered into items by RenderSort( )
+	std::vector<RenderItem>		items;
+	std::vector<Mat4>			models;			// transform from each item's list's frame to the scene's
+	std::vector<Mat4>			modelViews;		// ... and on to the eye's, from RenderTransform( )
+	Mat4						view;			// the scene to the eye, what GL is left with
+	Shading						*shading;		// per-pixel lighting this frame, NULL for fixed function
+	RenderCache					cache;
+	int							drawCalls;		// # of lists called this frame
+	int							vertices;		// # of vertices in them
+	int							culled;			// # of items the buffers left out this frame
+	int							occluded;		// # of them that were hidden rather than out of view
+	unsigned int				translucent;	// a bit per layer drawn blended, back to front
+	std::vector<int>			backToFront;	// the translucent layers' items, farthest first
+	std::vector<unsigned int>	depthKeys;		// the radix sort's keys ...
+	std::vector<unsigned int>	sortKeys;		// ... and its scratch space
+	std::vector<int>			sortItems;
+};
+
+void	RenderInit( RenderQueue * );
+int		RenderAddMaterial( RenderQueue *, const Material * );
+void	RenderTranslucent( RenderQueue *, int );
+void	RenderBegin( RenderQueue *, Shading *, int );
+void	RenderSubmit( RenderBuffer *, int, GLuint, int, GLuint, bool, int, int, const Mat4 * );
+void	RenderSort( RenderQueue * );
+void	RenderTransform( RenderQueue *, const Mat4 * );
+void	RenderDraw( RenderQueue *, int );
+
+#endif
@@ -0,0 +1,86 @@
+//
+//	The scene graph of the bodies -- see scenegraph.h.
+//
+
+#include <string.h>
+
+#include "scenegraph.h"
+
+
+void
+SceneInit( SceneGraph *sg )
+{
+	sg->parent.clear( );
+	sg->local.clear( );
+	sg->world.clear( );
+	sg->dirty.clear( );
+	sg->moved.clear( );
+	sg->updates = 0;
+}
+
+
+// add a node under parent (-1 for a root) and return its index:
+// (the parent must already have been added, which keeps every parent ahead
+//  of its children in the arrays)
+
+int
+SceneAdd( SceneGraph *sg, int parent )
+{
+	Mat4 identity;
+	Mat4Identity( &identity );
+	sg->parent.push_back( parent );
+	sg->local.push_back( identity );
+	sg->world.push_back( identity );
+	sg->dirty.push_back( 1 );
+	sg->moved.push_back( 0 );
+	return (int)sg->parent.size( ) - 1;
+}
+
+
+void
+SceneSetLocal( SceneGraph *sg, int node, const Mat4 *local )
+{
+	sg->local[node] = *local;
+	sg->dirty[node] = 1;
+}
+
+
+// (setting the same translation again leaves the node clean, so nothing
+//  below it is recomputed while the animation is frozen)
+
+void
+SceneSetTranslation( SceneGraph *sg, int node, float x, float y, float z )
+{
+	Mat4 t;
+	Mat4Translate( &t, x, y, z );
+	if( memcmp( &t, &sg->local[node], sizeof(Mat4) ) == 0 )
+		return;
+	sg->local[node] = t;
+	sg->dirty[node] = 1;
+}
+
+
+// bring every world matrix up to date:
+
+void
+SceneUpdate( SceneGraph *sg )
+{
+	int n = (int)sg->parent.size( );
+	sg->updates = 0;
+	for( int i = 0; i < n; i++ )
+	{
+		int p = sg->parent[i];
+		bool parentMoved = p >= 0  &&  sg->moved[p] != 0;
+		sg->moved[i] = 0;
+		if( sg->dirty[i] == 0  &&  ! parentMoved )
+			continue;
+
+		if( p < 0 )
+			sg->world[i] = sg->local[i];
+		else
+			Mat4Multiply( &sg->world[p], &sg->local[i], &sg->world[i] );
+		sg->dirty[i] = 0;
+		sg->moved[i] = 1;
+		sg->updates++;
+	}
+}
@@ -0,0 +1,33 @@
+//
+//	A flat, parent-indexed scene graph of the bodies: Sun -> planets -> moons.
+//
+//	Nodes live in one array and every node comes after its parent, so the
+//	world matrices are brought up to date in a single pass from the front.
+//	A node's world matrix is only recomputed when its own local matrix has
+//	been set since the last pass, or when its parent's world matrix changed --
+//	one 4x4 multiply per moved node, none for the ones that stayed still.
+
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <vector>
+
+#include "vecmath.h"
+
+struct SceneGraph
+{
+	std::vector<int>			parent;		// index of each node's parent, -1 for a root
+	std::vector<Mat4>			local;		// transform from the node's frame to its parent's
+	std::vector<Mat4>			world;		// transform from the node's frame to the scene's
+	std::vector<unsigned char>	dirty;		// != 0 when local has changed since the last update
+	std::vector<unsigned char>	moved;		// != 0 when world changed in the last update
+	int							updates;	// # of world matrices the last update recomputed
+};
+
+void	SceneInit( SceneGraph * );
+int		SceneAdd( SceneGraph *, int );
+void	SceneSetLocal( SceneGraph *, int, const Mat4 * );
+void	SceneSetTranslation( SceneGraph *, int, float, float, float );
+void	SceneUpdate( SceneGraph * );
+
+#endif
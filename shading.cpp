@@ -0,0 +1,364 @@
+//
+//	The GLSL lighting -- see shading.h.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "shading.h"
+
+// uniform buffer binding points:
+
+const int FRAME_BINDING = { 0 };
+const int BODY_BINDING  = { 1 };
+
+// std140 sizes of the two blocks:
+
+const int FRAME_BLOCK_SIZE = { 5 * 4 * sizeof(float) };
+const int BODY_BLOCK_SIZE  = { ( 6 + SHADOW_MAX_OCCLUDERS ) * 4 * sizeof(float) };
+
+// where the shadow fields are in a body's block, in floats:
+
+const int BODY_OCCLUDER_COUNT = { 10 };			// flags.z
+const int BODY_RING           = { 12 };			// ringCenter, ringNormal, ringRadii
+const int BODY_OCCLUDERS      = { 24 };
+
+// the shaders use the compatibility built-ins (gl_Vertex, gl_ModelViewMatrix, ...),
+// so they are GLSL 1.20, with uniform blocks from the extension:
+
+static const char *VertexSource =
+	"#version 120\n"
+	"varying vec3 vPosition;\n"
+	"varying vec3 vNormal;\n"
+	"varying vec2 vST;\n"
+	"void main( )\n"
+	"{\n"
+	"	vec4 p = gl_ModelViewMatrix * gl_Vertex;\n"
+	"	vPosition = p.xyz;\n"
+	"	vNormal = gl_NormalMatrix * gl_Normal;\n"
+	"	vST = gl_MultiTexCoord0.st;\n"
+	"	gl_Position = gl_ProjectionMatrix * p;\n"
+	"}\n";
+
+static const char *FragmentSource =
+	"#version 120\n"
+	"#extension GL_ARB_uniform_buffer_object : require\n"
+	"layout(std140) uniform Frame\n"
+	"{\n"
+	"	vec4 lightEye;		// the Sun, in eye coordinates\n"
+	"	vec4 lightDiffuse;\n"
+	"	vec4 lightSpecular;\n"
+	"	vec4 ambient;\n"
+	"	vec4 sunSize;		// x is the Sun's radius, in eye coordinates\n"
+	"};\n"
+	"layout(std140) uniform Body\n"
+	"{\n"
+	"	vec4 diffuse;\n"
+	"	vec4 specular;		// w is the shininess\n"
+	"	vec4 flags;			// emissive, textured, # of occluders\n"
+	"	vec4 ringCenter;	// a ring plane shading the body, in eye coordinates\n"
+	"	vec4 ringNormal;\n"
+	"	vec4 ringRadii;		// inner, outer, opacity -- 0 for no rings\n"
+	"	vec4 occluders[4];	// spheres that may shade it from the Sun: center, radius\n"
+	"};\n"
+	"uniform sampler2D tex;\n"
+	"varying vec3 vPosition;\n"
+	"varying vec3 vNormal;\n"
+	"varying vec2 vST;\n"
+	"\n"
+	"// how much of a disc of angular radius a is left uncovered by one of\n"
+	"// angular radius b, their centers c apart:\n"
+	"float Uncovered( float a, float b, float c )\n"
+	"{\n"
+	"	if( c >= a + b )\n"
+	"		return 1.;\n"
+	"	if( c <= b - a )\n"
+	"		return 0.;\n"
+	"	if( c <= a - b )\n"
+	"		return 1. - ( b * b ) / ( a * a );\n"
+	"	float a2 = a * a;\n"
+	"	float b2 = b * b;\n"
+	"	float overlap = a2 * acos( clamp( ( c*c + a2 - b2 ) / ( 2. * c * a ), -1., 1. ) )\n"
+	"		+ b2 * acos( clamp( ( c*c + b2 - a2 ) / ( 2. * c * b ), -1., 1. ) )\n"
+	"		- 0.5 * sqrt( max( ( -c + a + b ) * ( c + a - b ) * ( c - a + b ) * ( c + a + b ), 0. ) );\n"
+	"	return 1. - overlap / ( 3.14159265 * a2 );\n"
+	"}\n"
+	"\n"
+	"// the part of the Sun's disc that p can see past the occluders and rings:\n"
+	"float Sunlight( vec3 p )\n"
+	"{\n"
+	"	vec3 toSun = lightEye.xyz - p;\n"
+	"	float ds = length( toSun );\n"
+	"	float a = asin( min( sunSize.x / ds, 1. ) );\n"
+	"	float light = 1.;\n"
+	"	for( int i = 0; i < 4; i++ )\n"
+	"	{\n"
+	"		if( float( i ) >= flags.z )\n"
+	"			break;\n"
+	"		vec3 toOccluder = occluders[i].xyz - p;\n"
+	"		float d = length( toOccluder );\n"
+	"		if( d <= occluders[i].w  ||  d >= ds  ||  dot( toOccluder, toSun ) <= 0. )\n"
+	"			continue;\n"
+	"		float b = asin( occluders[i].w / d );\n"
+	"		float c = atan( length( cross( toOccluder, toSun ) ), dot( toOccluder, toSun ) );\n"
+	"		light *= Uncovered( a, b, c );\n"
+	"	}\n"
+	"	float across = dot( toSun, ringNormal.xyz );\n"
+	"	if( ringRadii.z > 0.  &&  abs( across ) > 1.e-6 * ds )\n"
+	"	{\n"
+	"		float t = dot( ringCenter.xyz - p, ringNormal.xyz ) / across;\n"
+	"		float r = length( p + t * toSun - ringCenter.xyz );\n"
+	"		if( t > 0.  &&  r >= ringRadii.x  &&  r <= ringRadii.y )\n"
+	"			light *= 1. - ringRadii.z;\n"
+	"	}\n"
+	"	return light;\n"
+	"}\n"
+	"\n"
+	"void main( )\n"
+	"{\n"
+	"	vec4 base = diffuse;\n"
+	"	if( flags.y > 0.5 )\n"
+	"		base *= texture2D( tex, vST );\n"
+	"	if( flags.x > 0.5 )\n"
+	"	{\n"
+	"		gl_FragColor = base;\n"
+	"		return;\n"
+	"	}\n"
+	"	vec3 n = normalize( gl_FrontFacing ? vNormal : -vNormal );\n"
+	"	vec3 l = normalize( lightEye.xyz - vPosition );\n"
+	"	vec3 h = normalize( l + normalize( -vPosition ) );\n"
+	"	float d = max( dot( n, l ), 0. );\n"
+	"	float s = d > 0. ? pow( max( dot( n, h ), 0. ), specular.w ) : 0.;\n"
+	"	if( d > 0. )\n"
+	"	{\n"
+	"		float shade = Sunlight( vPosition );\n"
+	"		d *= shade;\n"
+	"		s *= shade;\n"
+	"	}\n"
+	"	gl_FragColor = vec4( base.rgb * ( ambient.rgb + d * lightDiffuse.rgb ) + s * specular.rgb * lightSpecular.rgb, base.a );\n"
+	"}\n";
+
+
+static GLuint
+CompileShader( GLenum type, const char *source, const char *name )
+{
+	GLuint shader = glCreateShader( type );
+	glShaderSource( shader, 1, &source, NULL );
+	glCompileShader( shader );
+	GLint ok = GL_FALSE;
+	glGetShaderiv( shader, GL_COMPILE_STATUS, &ok );
+	if( ok != GL_TRUE )
+	{
+		char log[2048];
+		glGetShaderInfoLog( shader, sizeof(log), NULL, log );
+		fprintf( stderr, "Cannot compile the %s shader:\n%s\n", name, log );
+		glDeleteShader( shader );
+		return 0;
+	}
+	return shader;
+}
+
+
+static GLuint
+LinkProgram( GLuint vertex, GLuint fragment )
+{
+	GLuint program = glCreateProgram( );
+	glAttachShader( program, vertex );
+	glAttachShader( program, fragment );
+	glLinkProgram( program );
+	glDeleteShader( vertex );		// they go when the program does
+	glDeleteShader( fragment );
+	GLint ok = GL_FALSE;
+	glGetProgramiv( program, GL_LINK_STATUS, &ok );
+	if( ok != GL_TRUE )
+	{
+		char log[2048];
+		glGetProgramInfoLog( program, sizeof(log), NULL, log );
+		fprintf( stderr, "Cannot link the lighting program:\n%s\n", log );
+		glDeleteProgram( program );
+		return 0;
+	}
+	return program;
+}
+
+
+// build the program and the uniform buffers for nbodies bodies:
+// (returns false, with program left 0, if the driver has no GLSL or no
+//  uniform buffers, or the shaders do not build -- the caller then keeps
+//  to fixed function)
+
+bool
+ShadingInit( Shading *sh, int nbodies )
+{
+	sh->program = 0;
+	sh->frameBuffer = sh->bodyBuffer = 0;
+	sh->nbodies = nbodies;
+	sh->bodiesDirty = false;
+
+	if( ! GLEW_VERSION_2_0  ||  ! ( GLEW_VERSION_3_1  ||  GLEW_ARB_uniform_buffer_object ) )
+	{
+		fprintf( stderr, "No GLSL uniform buffers -- per-pixel lighting is not available\n" );
+		return false;
+	}
+
+	GLuint vertex = CompileShader( GL_VERTEX_SHADER, VertexSource, "vertex" );
+	GLuint fragment = CompileShader( GL_FRAGMENT_SHADER, FragmentSource, "fragment" );
+	if( vertex == 0  ||  fragment == 0 )
+	{
+		if( vertex != 0 )
+			glDeleteShader( vertex );
+		if( fragment != 0 )
+			glDeleteShader( fragment );
+		return false;
+	}
+	sh->program = LinkProgram( vertex, fragment );
+	if( sh->program == 0 )
+		return false;
+
+	glUniformBlockBinding( sh->program, glGetUniformBlockIndex( sh->program, "Frame" ), FRAME_BINDING );
+	glUniformBlockBinding( sh->program, glGetUniformBlockIndex( sh->program, "Body" ), BODY_BINDING );
+	glUseProgram( sh->program );
+	glUniform1i( glGetUniformLocation( sh->program, "tex" ), 0 );
+	glUseProgram( 0 );
+
+	// each body's block has to start on the driver's offset alignment:
+
+	GLint align = 0;
+	glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align );
+	if( align < 1 )
+		align = 256;
+	sh->bodyStride = ( ( BODY_BLOCK_SIZE + align - 1 ) / align ) * align;
+	sh->bodies.assign( (size_t)sh->bodyStride * nbodies, 0 );
+
+	glGenBuffers( 1, &sh->frameBuffer );
+	glBindBuffer( GL_UNIFORM_BUFFER, sh->frameBuffer );
+	glBufferData( GL_UNIFORM_BUFFER, FRAME_BLOCK_SIZE, NULL, GL_DYNAMIC_DRAW );
+	glGenBuffers( 1, &sh->bodyBuffer );
+	glBindBuffer( GL_UNIFORM_BUFFER, sh->bodyBuffer );
+	glBufferData( GL_UNIFORM_BUFFER, sh->bodies.size( ), NULL, GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+	glBindBufferBase( GL_UNIFORM_BUFFER, FRAME_BINDING, sh->frameBuffer );
+	return true;
+}
+
+
+// body b's material, the same one fixed function gets:
+// (emissive bodies, like the Sun, are not lit; textured ones multiply the
+//  color by the bound 2D texture)
+
+void
+ShadingSetBody( Shading *sh, int b, const Material *mat, bool emissive, bool textured )
+{
+	if( b < 0  ||  b >= sh->nbodies  ||  sh->program == 0 )
+		return;
+	float block[12] =
+	{
+		mat->diffuse[0],  mat->diffuse[1],  mat->diffuse[2],  mat->diffuse[3],
+		mat->specular[0], mat->specular[1], mat->specular[2], mat->shininess,
+		emissive ? 1.f : 0.f, textured ? 1.f : 0.f, 0., 0.
+	};
+	memcpy( &sh->bodies[ (size_t)b * sh->bodyStride ], block, sizeof(block) );
+	sh->bodiesDirty = true;
+}
+
+
+// the spheres that may shade body b from the Sun this frame, in eye
+// coordinates, radius last -- at most SHADOW_MAX_OCCLUDERS of them:
+
+void
+ShadingSetShadows( Shading *sh, int b, const float occluders[][4], int n )
+{
+	if( b < 0  ||  b >= sh->nbodies  ||  sh->program == 0 )
+		return;
+	if( n > SHADOW_MAX_OCCLUDERS )
+		n = SHADOW_MAX_OCCLUDERS;
+	float *block = (float *)&sh->bodies[ (size_t)b * sh->bodyStride ];
+	block[BODY_OCCLUDER_COUNT] = (float)n;
+	memcpy( &block[BODY_OCCLUDERS], occluders, n * 4 * sizeof(float) );
+	sh->bodiesDirty = true;
+}
+
+
+// a ring plane shading body b, in eye coordinates: its center, unit normal,
+// radii, and how much of the light it stops (0. for none):
+
+void
+ShadingSetRingShadow( Shading *sh, int b, const float center[3], const float normal[3], float inner, float outer,
+		float opacity )
+{
+	if( b < 0  ||  b >= sh->nbodies  ||  sh->program == 0 )
+		return;
+	float ring[12] =
+	{
+		center[0], center[1], center[2], 1.f,
+		normal[0], normal[1], normal[2], 0.f,
+		inner,     outer,     opacity,   0.f
+	};
+	float *block = (float *)&sh->bodies[ (size_t)b * sh->bodyStride ];
+	memcpy( &block[BODY_RING], ring, sizeof(ring) );
+	sh->bodiesDirty = true;
+}
+
+
+// this frame's lighting, as one upload, with the Sun's position and radius
+// already taken to eye coordinates:
+
+void
+ShadingSetFrame( Shading *sh, const FrameLighting *fl, const float sunEye[3], float sunRadius )
+{
+	if( sh->program == 0 )
+		return;
+	const PointLight *sun = &fl->sun;
+	float block[20] =
+	{
+		sunEye[0],          sunEye[1],          sunEye[2],          1.f,
+		sun->diffuse[0],    sun->diffuse[1],    sun->diffuse[2],    1.f,
+		sun->specular[0],   sun->specular[1],   sun->specular[2],   1.f,
+		fl->ambient[0],     fl->ambient[1],     fl->ambient[2],     1.f,
+		sunRadius,          0.,                 0.,                 0.
+	};
+	glBindBuffer( GL_UNIFORM_BUFFER, sh->frameBuffer );
+	glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof(block), block );
+	if( sh->bodiesDirty )
+	{
+		glBindBuffer( GL_UNIFORM_BUFFER, sh->bodyBuffer );
+		glBufferSubData( GL_UNIFORM_BUFFER, 0, sh->bodies.size( ), &sh->bodies[0] );
+		sh->bodiesDirty = false;
+	}
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+	glBindBufferBase( GL_UNIFORM_BUFFER, FRAME_BINDING, sh->frameBuffer );
+}
+
+
+// draw with the lighting program and body b's material until ShadingEnd( ):
+
+void
+ShadingBegin( Shading *sh, int b )
+{
+	ShadingUse( sh );
+	ShadingBindBody( sh, b );
+}
+
+
+// the two halves of ShadingBegin( ), for callers that keep track of which
+// program and body are already bound:
+
+void
+ShadingUse( Shading *sh )
+{
+	glUseProgram( sh->program );
+}
+
+
+void
+ShadingBindBody( Shading *sh, int b )
+{
+	glBindBufferRange( GL_UNIFORM_BUFFER, BODY_BINDING, sh->bodyBuffer, (GLintptr)b * sh->bodyStride, BODY_BLOCK_SIZE );
+}
+
+
+void
+ShadingEnd( Shading * )
+{
+	glUseProgram( 0 );
+}
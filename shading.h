@@ -0,0 +1,57 @@
+//
+//	Per-pixel lighting from the Sun with GLSL, as an alternative to the
+//	fixed-function lights and materials.
+//
+//	The shaders take their positions, normals and texture coordinates from
+//	the usual glVertex/glNormal/glTexCoord calls, so the same display lists
+//	draw with either path. What fixed function keeps in glLight and
+//	glMaterial state is held in two uniform buffers. The per-frame one has
+//	the frame's lighting block. The per-body one holds every body's
+//	material, one block apiece, and a body is picked by binding its range.
+//
+//	The fragment shader also shades bodies from the Sun analytically. Each
+//	body's block lists the few spheres that may be between it and the Sun,
+//	gathered on the CPU. The Sun is a disc of light, and what it lights
+//	falls off with how much of that disc each sphere covers, which gives
+//	umbra and penumbra without a shadow map. A body can be given a ring
+//	plane as well, for the shadow of Saturn's rings on Saturn.
+
+#ifndef SHADING_H
+#define SHADING_H
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <vector>
+
+#include "glew.h"
+#include "material.h"
+
+// the most spheres a body's block can list as shading it:
+// (the fragment shader's occluders[ ] must be this long)
+
+const int SHADOW_MAX_OCCLUDERS = { 4 };
+
+struct Shading
+{
+	GLuint	program;			// the lighting program, 0 if it could not be built
+	GLuint	frameBuffer;		// uniform buffer of the Frame block
+	GLuint	bodyBuffer;			// uniform buffer of every body's Body block
+	int		bodyStride;			// bytes between two bodies' blocks
+	int		nbodies;
+	std::vector<unsigned char> bodies;		// what goes into bodyBuffer
+	bool	bodiesDirty;		// bodies has changed since it was uploaded
+};
+
+bool	ShadingInit( Shading *, int );
+void	ShadingSetBody( Shading *, int, const Material *, bool, bool );
+void	ShadingSetShadows( Shading *, int, const float [][4], int );
+void	ShadingSetRingShadow( Shading *, int, const float [3], const float [3], float, float, float );
+void	ShadingSetFrame( Shading *, const FrameLighting *, const float [3], float );
+void	ShadingBegin( Shading *, int );
+void	ShadingUse( Shading * );
+void	ShadingBindBody( Shading *, int );
+void	ShadingEnd( Shading * );
+
+#endif
@@ -0,0 +1,218 @@
+//
+//	The solar system model -- see solarmodel.h.
+//
+
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <vector>
+#include <chrono>
+
+#include "solarmodel.h"
+
+const char *PlanetNames[NUMPLANETS] =
+{
+	"Mercury", "Venus", "Earth", "Mars", "Jupiter", "Saturn", "Uranus", "Neptune", "Pluto"
+};
+
+// (Mercury's eccentricity is reduced from 0.2056 so that its perihelion
+//  stays clear of the enlarged Sun)
+
+const PlanetElements PlanetOrbits[NUMPLANETS] =
+{
+	//	a			e			i			node		peri		M0
+	{   4.979f,	0.1000f,	 7.005f,	 48.331f,	 29.124f,	174.796f },		// Mercury
+	{   5.830f,	0.0068f,	 3.395f,	 76.680f,	 54.884f,	 50.115f },		// Venus
+	{   6.529f,	0.0167f,	 0.000f,	-11.261f,	114.208f,	358.617f },		// Earth
+	{   7.853f,	0.0934f,	 1.850f,	 49.558f,	286.502f,	 19.373f },		// Mars
+	{  17.154f,	0.0489f,	 1.303f,	100.464f,	273.867f,	 20.020f },		// Jupiter
+	{  28.127f,	0.0565f,	 2.485f,	113.665f,	339.392f,	317.020f },		// Saturn
+	{  52.517f,	0.0457f,	 0.773f,	 74.006f,	 96.999f,	142.239f },		// Uranus
+	{  80.026f,	0.0113f,	 1.770f,	131.784f,	273.187f,	256.228f },		// Neptune
+	{ 104.000f,	0.2488f,	17.160f,	110.299f,	113.834f,	 14.530f },		// Pluto
+};
+
+// the planets' masses, in Suns:
+
+const double PlanetMasses[NUMPLANETS] =
+{
+	1.660e-7,		// Mercury
+	2.448e-6,		// Venus
+	3.003e-6,		// Earth
+	3.227e-7,		// Mars
+	9.548e-4,		// Jupiter
+	2.859e-4,		// Saturn
+	4.366e-5,		// Uranus
+	5.151e-5,		// Neptune
+	6.580e-9,		// Pluto
+};
+
+// radius and a are in scene units, the radii to the same scale as the planets'
+// and a spread out enough to clear them; e, i and the period are the real ones,
+// the period in Earth days at the planets' spin rate of 1000 ms a day
+
+const MoonElements Moons[NUMMOONS] =
+{
+	//	name			planet		radius	a		e			i			period		color
+	{ "Luna",		EARTH,		0.093f,	0.60f,	0.0549f,	  5.145f,	27.322f,	{ 0.60f, 0.60f, 0.60f } },
+	{ "Io",			JUPITER,	0.098f,	4.40f,	0.0041f,	  2.21f,	 1.769f,	{ 0.90f, 0.80f, 0.40f } },
+	{ "Europa",		JUPITER,	0.084f,	5.00f,	0.0090f,	  1.79f,	 3.551f,	{ 0.80f, 0.75f, 0.65f } },
+	{ "Ganymede",	JUPITER,	0.141f,	5.80f,	0.0013f,	  2.21f,	 7.155f,	{ 0.60f, 0.55f, 0.50f } },
+	{ "Callisto",	JUPITER,	0.129f,	6.80f,	0.0074f,	  2.02f,	16.689f,	{ 0.40f, 0.37f, 0.33f } },
+	{ "Titan",		SATURN,		0.138f,	6.00f,	0.0288f,	  0.35f,	15.945f,	{ 0.85f, 0.65f, 0.30f } },
+	{ "Triton",		NEPTUNE,	0.073f,	2.00f,	0.0000f,	157.35f,	 5.877f,	{ 0.75f, 0.70f, 0.70f } },
+	{ "Charon",		PLUTO,		0.033f,	0.30f,	0.0002f,	119.59f,	 6.387f,	{ 0.55f, 0.50f, 0.50f } },
+};
+
+
+// the periods are scaled from the scene radii by Kepler's third law:
+
+float
+orbital_period_scale_factor( float t )
+{
+	return 500 * sqrt( t * t * t );
+}
+
+
+// set up the planets' and moons' orbits from their elements:
+
+void
+SolarModelInit( SolarModel *sm )
+{
+	KeplerInit( &sm->planets );
+	for( int p = 0; p < NUMPLANETS; p++ )
+	{
+		const PlanetElements *pe = &PlanetOrbits[p];
+		KeplerAdd( &sm->planets, pe->a, pe->e, pe->i, pe->node, pe->peri, pe->M0, orbital_period_scale_factor( pe->a ) );
+	}
+
+	KeplerInit( &sm->moons );
+	for( int m = 0; m < NUMMOONS; m++ )
+	{
+		const MoonElements *me = &Moons[m];
+		KeplerAdd( &sm->moons, me->a, me->e, me->i, 0., 0., 360.f * m / NUMMOONS, 1000.f * me->period );
+	}
+}
+
+
+// a body's number from its name, ignoring case, or -1 if there is no such body:
+
+int
+SolarModelFind( const char *name )
+{
+	for( int b = 0; b < NUMBODIES; b++ )
+	{
+		const char *bn = b < NUMPLANETS ? PlanetNames[b] : Moons[b - NUMPLANETS].name;
+		int k = 0;
+		while( bn[k] != '\0'  &&  tolower( bn[k] ) == tolower( name[k] ) )
+			k++;
+		if( bn[k] == '\0'  &&  name[k] == '\0' )
+			return b;
+	}
+	return -1;
+}
+
+
+// the positions of bodies[0 .. nbodies-1] at times[0 .. ntimes-1] into
+// xyz[ 3 * nbodies * ntimes ]:
+// body-major -- body k at time j is at xyz[ 3*( k*ntimes + j ) ] -- so each
+// body's track is one contiguous array, filled by one run of the propagator
+// vectorized across the times
+
+void
+SolarModelPositions( const SolarModel *sm, const int *bodies, int nbodies, const double *times, int ntimes,
+		float *xyz )
+{
+	std::vector<float> parent;
+	for( int k = 0; k < nbodies; k++ )
+	{
+		int b = bodies[k];
+		float *out = &xyz[ 3 * (size_t)k * ntimes ];
+		if( b < 0  ||  b >= NUMBODIES )
+		{
+			memset( out, 0, 3 * sizeof(float) * (size_t)ntimes );
+			continue;
+		}
+		if( b < NUMPLANETS )
+		{
+			KeplerPropagateTimes( &sm->planets, b, times, ntimes, out );
+			continue;
+		}
+
+		// a moon is its planet's position plus its own around the planet:
+
+		int m = b - NUMPLANETS;
+		parent.resize( 3 * (size_t)ntimes );
+		KeplerPropagateTimes( &sm->planets, Moons[m].planet, times, ntimes, &parent[0] );
+		KeplerPropagateTimes( &sm->moons, m, times, ntimes, out );
+		for( int j = 0; j < 3 * ntimes; j++ )
+			out[j] += parent[j];
+	}
+}
+
+
+static double
+ModelNowMs( )
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>( steady_clock::now( ).time_since_epoch( ) ).count( );
+}
+
+
+// the query benchmark -- every body at ntimes times a year apart, in bulk,
+// against the same positions asked for one time at a time:
+
+void
+SolarModelBenchmark( int ntimes )
+{
+	SolarModel sm;
+	SolarModelInit( &sm );
+
+	int bodies[NUMBODIES];
+	for( int b = 0; b < NUMBODIES; b++ )
+		bodies[b] = b;
+	std::vector<double> times( ntimes );
+	double year = orbital_period_scale_factor( PlanetOrbits[EARTH].a );
+	for( int j = 0; j < ntimes; j++ )
+		times[j] = j * year * 1.001;
+
+	std::vector<float> bulk( 3 * (size_t)NUMBODIES * ntimes );
+	double start = ModelNowMs( );
+	SolarModelPositions( &sm, bodies, NUMBODIES, &times[0], ntimes, &bulk[0] );
+	double bulkMs = ModelNowMs( ) - start;
+
+	std::vector<float> single( bulk.size( ) );
+	start = ModelNowMs( );
+	for( int k = 0; k < NUMBODIES; k++ )
+		for( int j = 0; j < ntimes; j++ )
+			SolarModelPositions( &sm, &bodies[k], 1, &times[j], 1, &single[ 3 * ( (size_t)k * ntimes + j ) ] );
+	double singleMs = ModelNowMs( ) - start;
+
+	float maxDiff = 0.;
+	for( size_t i = 0; i < bulk.size( ); i++ )
+		maxDiff = fabsf( bulk[i] - single[i] ) > maxDiff ? fabsf( bulk[i] - single[i] ) : maxDiff;
+
+	// far in the future, where the fastest orbits have made billions of turns:
+	// (10^10 to 10^15 ms, well past 2^31 turns of the inner moons)
+
+	const int NFAR = { 6 };
+	double far[NFAR];
+	for( int j = 0; j < NFAR; j++ )
+		far[j] = pow( 10., 10 + j );
+	std::vector<float> farXyz( 3 * (size_t)NUMBODIES * NFAR );
+	SolarModelPositions( &sm, bodies, NUMBODIES, far, NFAR, &farXyz[0] );
+	int notFinite = 0;
+	for( size_t i = 0; i < farXyz.size( ); i++ )
+		if( ! ( fabsf( farXyz[i] ) <= FLT_MAX ) )
+			notFinite++;
+
+	double positions = (double)NUMBODIES * ntimes;
+	printf( "query: %d bodies x %d times\n", NUMBODIES, ntimes );
+	printf( "\tbulk:       %9.2f ms  %8.2f Mpositions/s\n", bulkMs, positions / bulkMs / 1000. );
+	printf( "\tone by one: %9.2f ms  %8.2f Mpositions/s\n", singleMs, positions / singleMs / 1000. );
+	printf( "\tlargest difference %.2e\n", maxDiff );
+	printf( "\tfar future: %d of %d coordinates not finite\n", notFinite, (int)farXyz.size( ) );
+}
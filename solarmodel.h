@@ -0,0 +1,70 @@
+//
+//	The solar system model on its own -- the planets' and moons' orbits and
+//	a bulk position query -- with no GLUT or OpenGL, so it can be linked
+//	into tools that never open a window.
+//
+//	Bodies are numbered planets first, in order from the Sun, then moons,
+//	in the order of the Moons[ ] table. Positions are heliocentric scene
+//	coordinates (the ecliptic is the x-z plane and ecliptic north is +y) at
+//	times in milliseconds of simulation time.
+
+#ifndef SOLARMODEL_H
+#define SOLARMODEL_H
+
+#include "kepler.h"
+
+// the planets, in order from the Sun:
+
+enum Planets
+{
+	MERCURY,
+	VENUS,
+	EARTH,
+	MARS,
+	JUPITER,
+	SATURN,
+	URANUS,
+	NEPTUNE,
+	PLUTO,
+	NUMPLANETS
+};
+
+// the planets' orbital elements:
+// a is the scene orbit radius, the rest are the J2000 values in degrees
+
+struct PlanetElements
+{
+	float a, e, i, node, peri, M0;
+};
+
+// the moons' orbits around their planets, and how they look:
+
+struct MoonElements
+{
+	const char *name;
+	int			planet;
+	float		radius, a, e, i, period;
+	float		color[3];
+};
+
+const int NUMMOONS  = { 8 };
+const int NUMBODIES = { NUMPLANETS + NUMMOONS };
+
+extern const char *			PlanetNames[NUMPLANETS];
+extern const PlanetElements	PlanetOrbits[NUMPLANETS];
+extern const double			PlanetMasses[NUMPLANETS];
+extern const MoonElements	Moons[NUMMOONS];
+
+struct SolarModel
+{
+	KeplerSet	planets;		// the planets' orbits around the Sun
+	KeplerSet	moons;			// the moons' orbits around their planets
+};
+
+void	SolarModelInit( SolarModel * );
+int		SolarModelFind( const char * );
+void	SolarModelPositions( const SolarModel *, const int *, int, const double *, int, float * );
+void	SolarModelBenchmark( int );
+float	orbital_period_scale_factor( float );
+
+#endif
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stddef.h>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -23,7 +24,26 @@
 #include <GL/glu.h>
 #include "glut.h"
 
+#include "kepler.h"
+#include "solarmodel.h"
+#include "asteroids.h"
+#include "nbody.h"
+#include "scenegraph.h"
+#include "ephemeris.h"
+#include "spk.h"
+#include "spatial.h"
+#include "comets.h"
+#include "shading.h"
+#include "renderqueue.h"
+#include "material.h"
+#include "vecmath.h"
+#include "jobs.h"
+#include "truescale.h"
+#include "depth.h"
+
 #include <vector>
+#include <algorithm>
+#include <chrono>
 #define OBJDELIMS	" \t"
 
 struct Vertex
@@ -78,6 +98,14 @@ const float SCLFACT = { 0.005f };
 
 const float MINSCALE = { 0.05f };
 
+// in true scale, Scale zooms the eye in from TRUE_VIEW_RADII radii above the
+// body it looks at, by a factor of e every 1/TRUE_ZOOM_RATE, and the near
+// clip plane comes no closer than TRUE_MIN_NEAR_KM:
+
+const float  TRUE_VIEW_RADII  = { 3.f };
+const float  TRUE_ZOOM_RATE   = { 4.f };
+const double TRUE_MIN_NEAR_KM = { 0.001 };
+
 // scroll wheel button values:
 
 const int SCROLL_WHEEL_UP   = { 3 };
@@ -174,20 +202,314 @@ const GLfloat FOGEND      = { 4. };
 //#define DEMO_Z_FIGHTING
 //#define DEMO_DEPTH_BUFFER
 
+// the render passes timed by the profiler:
+// this order must match the PassNames order
+
+enum Passes
+{
+	PASS_SUN,
+	PASS_ORBITS,
+	PASS_PLANETS,
+	PASS_MOONS,
+	PASS_ASTEROIDS,
+	PASS_COMETS,
+	PASS_RINGS,
+	PASS_SKYBOX,
+	NUMPASSES
+};
+
+const char *PassNames[ ] = { "Sun", "Orbits", "Planets", "Moons", "Asteroids", "Comets", "Rings", "Skybox" };
+
+// # of frames of gpu timer queries kept in flight:
+// (a frame's results are read back this many frames later, when the
+//  gpu has long finished with them, so reading them never stalls)
+
+const int NUMQUERYFRAMES = { 4 };
+
+// # of frames averaged into each profiler report:
+
+const int PROFILE_REPORT_FRAMES = { 120 };
+
+// the hud's frame-time graph:
+
+const int   HUD_GRAPH_FRAMES = { 120 };		// # of frames shown
+const float HUD_GRAPH_MAXMS  = { 50. };		// frame time at the top of the graph
+
+// the hud's glyph atlas holds the printable ascii characters of
+// GLUT_BITMAP_8_BY_13 in a 16 x 6 grid of cells:
+
+const int GLYPH_W      = { 8 };
+const int GLYPH_H      = { 14 };
+const int GLYPH_COLS   = { 16 };
+const int GLYPH_FIRST  = { 32 };
+const int GLYPH_LAST   = { 126 };
+const int ATLAS_SIZE   = { 128 };
+
+// the asteroid belt:
+// (it sits between Mars at 7.853 and Jupiter at 17.154; the number propagated
+//  each frame is cut back from NUMASTEROIDS to fit in ASTEROID_BUDGET_MS)
+
+const int   NUMASTEROIDS        = { 1000000 };
+const float ASTEROID_AMIN       = { 9.0f };
+const float ASTEROID_AMAX       = { 14.5f };
+const float ASTEROID_BUDGET_MS  = { 4.0f };
+const float ASTEROID_POINT_SIZE = { 2.0f };
+const int   SPRITE_SIZE         = { 16 };
+
+// Saturn's ring particles:
+// (the bands are the C, B and A rings, spread over the old annulus's 3.5 to 4.5
+//  with the Cassini division between B and A; the periods follow Kepler's third
+//  law from Saturn's mass at 18,640 km a scene unit and 1000 ms a day; closer
+//  than RING_PARTICLE_PIXELS across, the particles take over from the annulus)
+
+const int   NUMRINGPARTICLES     = { 60000 };
+const float RING_PERIOD_SCALE    = { 30.1f };
+const float RING_BUDGET_MS       = { 1.0f };
+const float RING_POINT_SIZE      = { 1.5f };
+const float RING_PARTICLE_PIXELS = { 150.f };
+
+// how much of the Sun's light the ring annulus stops, in the shadow it casts:
+
+const float RING_SHADOW_OPACITY  = { 0.6f };
+
+const RingBand RingBands[ ] =
+{
+	//	amin	amax	share
+	{ 3.50f,	3.78f,	0.15f },		// C ring
+	{ 3.78f,	4.19f,	0.55f },		// B ring
+	{ 4.27f,	4.50f,	0.30f },		// A ring
+};
+
+const int NUMRINGBANDS = { sizeof(RingBands) / sizeof(RingBands[0]) };
+
+// sphere tessellation, slices and stacks:
+// (Gouraud shading needs the fine one for the highlights to look round;
+//  per-pixel lighting looks the same with far fewer vertices)
+
+const int SPHERE_SLICES          = { 50 };
+const int SPHERE_SLICES_PERPIXEL = { 20 };
+const int MOON_SLICES            = { 24 };
+
+// how each planet looks: its texture, a fixed turn about y, then its spin
+// period in ms at 1000 ms a day (negative for retrograde):
+
+struct PlanetLook
+{
+	float	radius;			// scene units
+	int		texture;		// index into Tex[ ]
+	float	turn;			// degrees
+	int		period;
+};
+
+const PlanetLook PlanetLooks[NUMPLANETS] =
+{
+	{ 0.131f,	 1,	  0.0f,	  58646 },		// Mercury, 58.646 Earth days
+	{ 0.325f,	 2,	177.0f,	-243018 },		// Venus, -243.018 Earth days
+	{ 0.342f,	 3,	 23.5f,	    997 },		// Earth, .997 days
+	{ 0.182f,	 4,	 25.0f,	   1026 },		// Mars, 1.026 Earth days
+	{ 3.75f,	 5,	  3.0f,	    413 },		// Jupiter, 0.41353 Earth days
+	{ 3.124f,	 6,	 27.0f,	    444 },		// Saturn, 0.44403 Earth days
+	{ 1.360f,	 8,	 98.0f,	   -718 },		// Uranus, -0.71833 Earth days
+	{ 1.321f,	 9,	 30.0f,	    671 },		// Neptune, 0.67125 Earth days
+	{ 0.127f,	10,	118.0f,	  -6375 },		// Pluto, 6.375 Earth days
+};
+
+const float SUN_RADIUS          = { 4.f };
+const int   SUN_ROTATION_PERIOD = { 25379 };		// 25.379 Earth days
+
+// the frame's render packets: the Sun, the planets, the moons and Saturn's
+// ring annulus, built as jobs of PACKET_JOB_SIZE:
+
+const int NUMPACKETS      = { 1 + NUMPLANETS + NUMMOONS + 1 };
+const int PACKET_JOB_SIZE = { 4 };
+
+// the moons propagated by each job:
+
+const int MOON_JOB_SIZE = { 4 };
+
+// each lit body's block in the per-pixel lighting's uniform buffer:
+
+enum ShadedBodies
+{
+	BODY_SUN,
+	BODY_PLANETS,
+	BODY_RINGS = BODY_PLANETS + NUMPLANETS,
+	BODY_MOONS,
+	NUMSHADEDBODIES = BODY_MOONS + NUMMOONS
+};
+
+// the comets:
+// (each sheds its tails into a ring of COMET_CAPACITY particles)
+
+const int   NUMCOMETS        = { 24 };
+const int   COMET_CAPACITY   = { 16384 };
+const float COMET_POINT_SIZE = { 2.0f };
+const float NUCLEUS_SIZE     = { 4.0f };
+
+// the planets' ephemeris tables:
+// (fitted at startup over the first EPHEMERIS_YEARS Earth years of simulation
+//  time -- past that the planets are propagated from their elements again)
+
+const int EPHEMERIS_YEARS     = { 200 };
+const int EPHEMERIS_PER_ORBIT = { 4 };			// segments per orbit of each planet
+const int EPHEMERIS_DEGREE    = { 10 };
+const float EPHEMERIS_STALE   = { 1.e-3f };		// a loaded table this far off the elements (beyond its fit error) is refitted
+const int EPHEMERIS_SAMPLES   = { 97 };			// # of times across the span a loaded table is checked at
+
+// the real planets, from an SPK kernel:
+// (simulation time 0 is J2000 and the clock runs one real year per scene Earth
+//  year; the real heliocentric directions are kept and each planet's distance
+//  is scaled by its scene orbit radius over its real semi-major axis)
+
+const double SPK_SECONDS_PER_YEAR = { 365.25 * 86400. };
+const double SPK_KM_PER_AU        = { 149597870.7 };
+const double SPK_OBLIQUITY        = { 23.4392911 };		// J2000 equator to ecliptic, degrees
+
+// gravity mode:
+// (masses are in Suns, so G is the Sun's GM in scene units and simulation
+//  milliseconds -- the value that gives the Keplerian periods of 500 a^1.5)
+
+const double NBODY_G          = { 4. * M_PI * M_PI / ( 500. * 500. ) };
+const double NBODY_SOFTENING  = { 0.01 };
+const double NBODY_THETA      = { 0.5 };
+const double NBODY_STEP_MS    = { 5. };			// about 1/1000 of Mercury's year
+const int    NBODY_MAX_STEPS  = { 200 };		// per frame -- beyond that the steps get longer
+const int    NBODY_ENERGY_EVERY = { 60 };		// frames between energy checks
+const float  SWARM_AMIN       = { 20.f };		// the test swarm sits between Jupiter and Uranus
+const float  SWARM_AMAX       = { 45.f };
+const double SWARM_MASS       = { 1.e-10 };
+const float  CLOSE_APPROACH   = { 0.1f };		// bodies nearer than this are reported as close
+
+// limits of the simulation time warp:
+
+const float MINTIMEWARP = { 1.f/16.f };
+const float MAXTIMEWARP = { 4096.f };
+
+// the benchmark advances the simulation by a fixed step each frame
+// so that every run renders exactly the same sequence of scenes:
+
+const double BENCH_DT_MS         = { 1000. / 60. };
+const int    BENCH_WARMUP_FRAMES = { 60 };
+const int    BENCH_FRAMES        = { 600 };
+
+// scripted camera paths for the benchmark:
+// (the keys are interpolated linearly -- t runs from 0. to 1. over the measured frames)
+
+struct CameraKey
+{
+	float t;
+	float xrot, yrot;		// degrees
+	float scale;
+	float timewarp;
+};
+
+const CameraKey OverviewKeys[ ] =
+{
+	{ 0.00f,   0.f,   0.f, 1.0f,    1.f },
+	{ 0.50f,  20.f, 180.f, 1.0f,    8.f },
+	{ 1.00f,   0.f, 360.f, 1.0f,    1.f },
+};
+
+const CameraKey InnerKeys[ ] =
+{
+	{ 0.00f,  10.f,   0.f, 4.0f,    1.f },
+	{ 0.50f,  30.f,  90.f, 6.0f,    1.f },
+	{ 1.00f,  10.f, 180.f, 4.0f,    1.f },
+};
+
+const CameraKey OuterKeys[ ] =
+{
+	{ 0.00f,  60.f,   0.f, 0.8f,   64.f },
+	{ 1.00f,  60.f,  90.f, 0.8f,   64.f },
+};
+
+const CameraKey WarpKeys[ ] =
+{
+	{ 0.00f,  15.f,  45.f, 1.5f,    1.f },
+	{ 0.50f,  15.f,  45.f, 1.5f,   64.f },
+	{ 1.00f,  15.f,  45.f, 1.5f, 4096.f },
+};
+
+struct CameraPath
+{
+	const char *		name;
+	int					nkeys;
+	const CameraKey *	keys;
+};
+
+const CameraPath CameraPaths[ ] =
+{
+	{ "overview", sizeof(OverviewKeys) / sizeof(CameraKey), OverviewKeys },
+	{ "inner",    sizeof(InnerKeys)    / sizeof(CameraKey), InnerKeys    },
+	{ "outer",    sizeof(OuterKeys)    / sizeof(CameraKey), OuterKeys    },
+	{ "warp",     sizeof(WarpKeys)     / sizeof(CameraKey), WarpKeys     },
+};
+
+const int NUMCAMERAPATHS = { sizeof(CameraPaths) / sizeof(CameraPath) };
+
+// the frame-time histogram:
+// frame times are recorded in microseconds into log-linear buckets, as in an
+// hdr histogram -- values below 2^HIST_SUBBITS are exact, larger values are kept
+// to within 1 part in 2^(HIST_SUBBITS-1), up to 2^HIST_MAXBITS microseconds
+
+const int    HIST_SUBBITS = { 7 };
+const int    HIST_MAXBITS = { 27 };			// ~134 seconds
+const int    HIST_BUCKETS = { ( HIST_MAXBITS - HIST_SUBBITS + 2 ) << ( HIST_SUBBITS - 1 ) };
+const double FRAMESTALL_MS = { 50. };		// frames longer than this count as stalls
+
+// the stages of startup that are timed:
+// this order must match the StartupStageNames order
+
+enum StartupStages
+{
+	STARTUP_GLUTINIT,
+	STARTUP_WINDOW,
+	STARTUP_TEXTURES,
+	STARTUP_GLEW,
+	STARTUP_RESET,
+	STARTUP_LISTS,
+	STARTUP_EPHEMERIS,
+	STARTUP_ASTEROIDS,
+	STARTUP_COMETS,
+	STARTUP_MENUS,
+	STARTUP_FIRSTFRAME,
+	NUMSTARTUPSTAGES
+};
+
+const char *StartupStageNames[ ] =
+{
+	"glutInit", "window", "textures", "glew", "Reset", "InitLists", "ephemeris", "asteroids", "comets", "InitMenus", "first frame"
+};
+
 // non-constant global variables:
 
 int		ActiveButton;			// current button that is down
+int		BenchmarkOn;			// != 0 means to replay the camera paths and exit
+int		ColdStartOn;			// != 0 means to exit as soon as the first frame has been presented
 GLuint	AxesList;				// list to hold the axes
+int		AsteroidsOn;			// != 0 means to draw the asteroid belt
+int		CometsOn;				// != 0 means to draw the comets
+int		PerPixelOn;				// != 0 means to light with the GLSL shaders, when they built
+int		RingParticlesOn;		// != 0 means to draw Saturn's rings as particles when close enough
+int		TrueScaleOn;			// != 0 means to show the bodies at their real sizes and distances
+int		OcclusionOn;			// != 0 means to leave out bodies hidden behind the Sun or a planet
+int		ShadowsOn;				// != 0 means the planets, moons and rings shade each other (per-pixel only)
 int		AxesOn;					// != 0 means to draw the axes
 int		DebugOn;				// != 0 means to print debugging info
 int		DepthCueOn;				// != 0 means to use intensity depth cueing
 int		DepthBufferOn;			// != 0 means to use the z-buffer
 int		DepthFightingOn;		// != 0 means to force the creation of z-fighting
+int		GravityOn;				// != 0 means to move the planets by n-body gravity instead of Kepler orbits
+int		HudOn;					// != 0 means to draw the performance hud
 int		Frozen;
 bool	Light0On = 1;
 int		MainWindow;				// window id for main graphics window
+int		ProfileOn;				// != 0 means to print per-pass cpu and gpu timings
 float	Scale;					// scaling factor
 float	Time;					// timer in the range [0.,1.)
+double	SimTime;				// simulation time in milliseconds, advanced by Animate( )
+double	LastAnimateMs;			// wall-clock time of the previous Animate( ), 0. if there is none
+float	TimeWarp;				// simulation milliseconds per wall-clock millisecond
 int		WhichColor;				// index into Colors[ ]
 int		WhichProjection;		// ORTHO or PERSP
 int		Xmouse, Ymouse;			// mouse values
@@ -196,8 +518,6 @@ float	Xrot, Yrot;				// rotation angles in degrees
 int		NumLngs, NumLats;		// Variables for sphere generation
 struct	point* Pts;
 
-float White[3] = { 1., 1., 1. };
-
 unsigned char* Texture[12];		// array holding the texel colors
 int width;						// width of texture map
 int height;						// height of texture map
@@ -205,19 +525,94 @@ int level;						// used with mip-mapping
 int ncomps;						// # of components in texture
 int border;						// width of texture border
 
+// profiler state:
+
+bool	GpuTimersOn;								// true if GL_TIME_ELAPSED queries are supported
+GLuint	PassQueries[NUMQUERYFRAMES][NUMPASSES];		// ring of gpu timer queries
+bool	PassQueryPending[NUMQUERYFRAMES][NUMPASSES];	// true if the query was issued and not yet read
+int		QueryFrame;									// frame being recorded, used modulo NUMQUERYFRAMES
+int		QueriesDropped;								// results that were not ready when their slot came around
+double	FrameStartMs;								// cpu time the current frame began
+double	PassStartMs[NUMPASSES];						// cpu time each pass began
+double	PassCpuMs[NUMPASSES];						// cpu ms accumulated since the last report
+double	PassGpuMs[NUMPASSES];						// gpu ms accumulated since the last report
+int		PassGpuSamples[NUMPASSES];					// # of gpu results accumulated since the last report
+double	FrameCpuMs;									// whole-frame cpu ms accumulated since the last report
+int		ProfileFrames;								// # of frames accumulated since the last report
+
+// hud state:
+
+int		DrawCalls;									// draw calls issued so far this frame
+int		VerticesSubmitted;							// vertices submitted so far this frame
+std::vector<int> ListVertices;						// # of vertices in each display list, by list id
+int		ListVertexCount;							// vertices emitted into the list being compiled
+long	TextureBytes;								// bytes of texel data handed to opengl
+float	FrameTimes[HUD_GRAPH_FRAMES];				// ring of recent frame times, in ms
+int		FrameTimeIndex;								// next slot to fill in FrameTimes
+double	LastFrameStartMs;							// wall-clock start of the previous frame
+// frame-time metrics:
+
+struct FrameHistogram
+{
+	long long	counts[HIST_BUCKETS];	// # of frames in each bucket
+	long long	total;					// # of frames recorded
+	long long	stalls;					// # of frames longer than FRAMESTALL_MS
+	double		sumMs;					// for the mean
+	double		maxMs;					// exact, not bucketed
+};
+
+FrameHistogram	FrameHist;
+const char *	MetricsName = "frametimes";		// base name of the exported .csv and .json
+bool			MetricsOnExit;					// true if the metrics are exported when the program exits
+const char *	EphemerisFile;					// where the ephemeris tables are cached, NULL for nowhere
+const char *	SpkFileName;					// SPK kernel to take the planets from, NULL for none
+int				DepthModeAsked;					// DEPTH_STANDARD or DEPTH_REVERSED, from -depth
+const char *	PositionSource = "elements";	// what placed the planets this frame, for the hud
+
+// startup timing:
+
+double	StartupLastMs;								// when the previous stage finished
+double	StartupMs[NUMSTARTUPSTAGES];				// how long each stage took
+bool	FirstFramePresented;
+
+// benchmark state:
+
+int		BenchPath;									// index into CameraPaths
+int		BenchLastPath;								// last path to run
+int		BenchWarmup;								// # of warm-up frames per path
+int		BenchFrames;								// # of measured frames per path
+int		BenchFrame;									// frame of the current path, counting the warm-up
+double	BenchLastMs;								// wall-clock end of the previous frame
+std::vector<double> BenchTimes;						// measured frame times of the current path
+
+GLuint	GlyphAtlas;									// alpha texture of the hud font, 0 until built
+std::vector<GLfloat> HudVerts;						// quads of the hud text: x, y, s, t per vertex
+
 
 // function prototypes:
 
 void	Animate( );
 void	Display( );
+void	DoAsteroidsMenu( int );
 void	DoAxesMenu( int );
+void	DoCometsMenu( int );
 void	DoColorMenu( int );
 void	DoDepthBufferMenu( int );
 void	DoDepthFightingMenu( int );
 void	DoDepthMenu( int );
+void	DoGravityMenu( int );
+void	DoHudMenu( int );
+void	DoJobsMenu( int );
+void	DoLightingMenu( int );
 void	DoDebugMenu( int );
 void	DoMainMenu( int );
+void	DoProfileMenu( int );
 void	DoProjectMenu( int );
+void	DoStateCacheMenu( int );
+void	DoTrueScaleMenu( int );
+void	DoOcclusionMenu( int );
+void	DoShadowsMenu( int );
+void	DoRingsMenu( int );
 void	DoShadowMenu();
 void	DoRasterString( float, float, float, char * );
 void	DoStrokeString( float, float, float, float, char * );
@@ -228,6 +623,7 @@ void	InitMenus( );
 void	Keyboard( unsigned char, int, int );
 void	MouseButton( int, int, int, int );
 void	MouseMotion( int, int );
+double	NowMs( );
 void	Reset( );
 void	Resize( int, int );
 void	Visibility( int );
@@ -238,24 +634,164 @@ void			HsvRgb( float[3], float [3] );
 int				ReadInt( FILE * );
 short			ReadShort( FILE * );
 
-void			Cross(float[3], float[3], float[3]);
-float			Dot(float [3], float [3]);
-float			Unit(float [3], float [3]);
 
 void	OsuSphere(float, int, int);
 
-void	SetMaterial(float, float, float, float);
-void	SetPointLight(int, float, float, float, float, float, float);
-
-float*	Array3(float, float, float);
-float*	MulArray3(float, float[3]);
-
-void	orbital_path(float);
-float	orbital_period_scale_factor(float);
+void	InitMaterials( );
+
+void	orbital_path(int);
+void	InitOrbits();
+void	InitAsteroids( );
+void	DrawAsteroids( );
+int		DrawParticles( AsteroidBelt *, GLuint, std::vector<float> *, int, float, float, float, float );
+float	PixelRadius( const Mat4 *, float );
+void	InitComets( );
+void	InitShading( );
+void	InitDepth( );
+void	InitRenderQueue( );
+void	InitSphereLists( int );
+int		SphereSlicesWanted( );
+void	QueueBodies( double );
+void	BuildPackets( void *, int, int, int );
+void	BuildPacket( RenderBuffer *, int, double );
+void	QueueList( RenderBuffer *, int, GLuint, GLuint, bool, int, int, const Mat4 *, float );
+void	TrueScaleView( const Quat * );
+void	GatherOccluders( );
+void	GatherShadows( float * );
+void	ShadedBodySphere( int, float [3], float * );
+bool	SphereHidden( const float [3], float );
+const char *TrueBodyName( int );
+void	InitJobs( );
+void	ShutdownJobs( );
+void	PropagateMoons( void *, int, int, int );
+void	DrawComets( );
+void	InitEphemeris( );
+void	PlanetSource( void *, int, double, double [3] );
+void	InitSpk( );
+bool	SpkPlanets( double );
+void	InitScene( );
+void	UpdateScene( );
+void	InitGravity( );
+void	StepGravity( );
+void	DrawSwarm( );
+bool	RunCpuBenchmarks( int, char *[ ] );
 void	saturn_rings(float, float);
 
 void	DeepSpace();
 
+void	InitProfiler( );
+void	ProfileBegin( int );
+void	ProfileEnd( int );
+void	ProfileFrameBegin( );
+void	ProfileFrameEnd( );
+void	ProfileReport( );
+void	ProfileResetCounters( );
+
+void	CallList( GLuint );
+void	RecordListVertices( GLuint );
+void	InitGlyphAtlas( );
+void	HudText( float, float, const char * );
+void	DrawHud( );
+
+bool	ParseArgs( int, char *[ ] );
+void	BenchmarkAnimate( );
+void	BenchmarkFrameDone( );
+void	BenchmarkReport( );
+void	BenchmarkStartPath( int );
+
+int		HistBucket( long long );
+double	HistBucketLowMs( int );
+double	HistBucketHighMs( int );
+void	HistRecord( FrameHistogram *, double );
+double	HistPercentile( const FrameHistogram *, double );
+void	ExportFrameTimes( );
+
+void	StartupMark( int );
+void	StartupReport( );
+
+SolarModel	Model;						// the planets' and moons' orbits
+float		PlanetPos[NUMPLANETS][3];	// where the planets are this frame
+Ephemeris	PlanetEph;					// Model.planets fitted with Chebyshev polynomials
+
+// the planets' NAIF ids and real semi-major axes, for the SPK kernel:
+// (the DE kernels have Mercury and Venus as their own barycenters, and the
+//  outer planets' barycenters are within a planet radius of the planets)
+
+const int PlanetSpkIds[NUMPLANETS] = { 1, 2, 399, 4, 5, 6, 7, 8, 9 };
+
+const double PlanetAu[NUMPLANETS] =
+{
+	0.38710, 0.72333, 1.00000, 1.52368, 5.20260, 9.55491, 19.21845, 30.11039, 39.48168
+};
+
+SpkFile		Kernel;						// the mapped SPK kernel, Kernel.base is NULL if there is none
+
+std::vector<float> MoonPos;				// where they are this frame, relative to their planets
+
+SceneGraph	Scene;						// the Sun, the planets under it, and the moons under them
+int			SunNode;					// the Sun's node in Scene
+int			PlanetNodes[NUMPLANETS];	// the planets' nodes
+int			MoonNodes[NUMMOONS];		// the moons' nodes
+SceneGraph	Rebased;					// the same nodes with no parents, relative to the true-scale eye, km
+SceneGraph	*DrawScene;					// the one drawn this frame: Scene, or Rebased in true scale
+
+TrueCamera	TrueEye;					// the true-scale eye, in double precision
+double		TruePos[3*NUMTRUEBODIES];	// the bodies' true-scale positions this frame, heliocentric km
+float		TrueAltitudeKm;				// the eye's height above the surface of the body it looks at
+float		TrueSkyScale;				// how much the sky box is blown up to reach the far plane
+
+NBodySystem	Gravity;					// the Sun, the planets and the swarm, in that order, in gravity mode
+double		GravityTime;				// simulation time Gravity has been integrated to
+double		GravityE0;					// its total energy when gravity mode was turned on
+double		GravityDrift;				// relative change in the total energy since then
+double		GravityStepMs;				// cpu time of the last integration step
+int			GravityFrames;				// frames since gravity mode was turned on
+int			SwarmSize;					// # of test bodies added to the n-body run
+std::vector<float> GravityXyz;			// all the bodies' positions, relative to the Sun
+SpatialGrid	Approaches;					// grid over GravityXyz for finding close approaches
+std::vector<SpatialPair> ClosePairs;	// the bodies closer than CLOSE_APPROACH this frame
+std::vector<float> CloseLines;			// a line between each close pair, for drawing
+
+AsteroidBelt	Belt;						// the asteroids' orbits and their cpu budget
+GLuint			AsteroidBuffer;				// vertex buffer the positions are streamed into, 0 if none
+std::vector<float> AsteroidXyz;				// the positions, when there is no vertex buffer to map
+int				AsteroidsDrawn;				// # of asteroids drawn this frame
+GLuint			SpriteTex;					// round point-sprite texture
+
+AsteroidBelt	Rings;						// Saturn's ring particles, around Saturn
+GLuint			RingBuffer;					// vertex buffer their positions are streamed into, 0 if none
+std::vector<float> RingXyz;					// the positions, when there is no vertex buffer to map
+int				RingParticlesDrawn;			// # of ring particles drawn this frame, 0 if the annulus was
+
+CometSystem		Comets;						// the comets' orbits and their tails' particle rings
+GLuint			CometBuffer;				// vertex buffer the tails are streamed into, 0 if none
+std::vector<CometVertex> CometVerts;		// the tails, when there is no vertex buffer to map
+int				CometParticlesDrawn;		// # of tail particles drawn this frame
+FrameLighting	Lighting;					// the Sun's light and the ambient level, set up once a frame
+Material		WhiteMaterial;				// the planets', the ring annulus's and the sky's material
+Material		MoonMaterial[NUMMOONS];		// the moons' plain colored ones
+
+Shading			Shader;						// the per-pixel lighting program and its uniform buffers
+bool			PerPixelNow;				// true while this frame is lit per-pixel
+DepthBuffer		Depth;						// the depth buffer the scene is drawn with
+int				SphereSlices;				// how finely the sphere lists are tessellated now
+
+RenderQueue		Queue;						// this frame's Sun, planets, moons and ring annulus
+int				WhiteMaterialId;			// WhiteMaterial's index in Queue
+int				MoonMaterialIds[NUMMOONS];	// and the moons'
+Mat4			RingFrame;					// Saturn's rings' frame this frame
+Mat4			Projection;					// the eye to clip coordinates, made on the CPU each frame
+Mat4			View;						// the scene to the eye
+float			FrustumPlanes[6][4];		// what Projection * View can see, in scene coordinates
+GLsizei			ViewportSize;				// the square viewport's side, in pixels
+float			Occluders[1+NUMPLANETS][4];	// the Sun's and planets' spheres in eye coordinates, radius last
+int				NumOccluders;				// 0 when occlusion culling is off
+float			ViewScale;					// how much View scales lengths by
+bool			ViewOrtho;					// true for an orthographic projection
+
+JobSystem		Jobs;						// the worker threads, the GL thread being thread 0
+bool			RingParticlesNow;			// true when the rings are drawn as particles this frame
+
 // Sun and planet display lists, textures, and function that sets them
 GLuint	Sun;
 GLuint	Mercury;
@@ -265,6 +801,7 @@ GLuint	Mars;
 GLuint	Jupiter;
 GLuint	Saturn;
 GLuint	SaturnRings;
+GLuint	MoonSphere;				// unit sphere, scaled to each moon
 GLuint	Uranus;
 GLuint	Neptune;
 GLuint	Pluto;
@@ -275,17 +812,39 @@ char* textures[12] = {"sun.bmp", "mercury.bmp", "venus.bmp", "earth.bmp", "mars.
 					  "neptune.bmp", "pluto.bmp", "stars.bmp"};
 GLuint	Tex[12];
 
+// the rings' texture is given an alpha from its brightness, so that the
+// gaps between the rings show what is behind them:
+
+const int RINGS_TEXTURE = { 7 };
+
 
 // main program:
 
 int
 main( int argc, char *argv[ ] )
 {
+	// the cpu-only benchmarks don't need a window, so run them before glut opens one:
+
+	if( RunCpuBenchmarks( argc, argv ) )
+		return 0;
+
+	// startup is timed from here to the first presented frame:
+
+	StartupLastMs = NowMs( );
+
 	// turn on the glut package:
 	// (do this before checking argc and argv since it might
 	// pull some command line arguments out)
 
 	glutInit( &argc, argv );
+	StartupMark( STARTUP_GLUTINIT );
+
+	// look at what glut left of the command line:
+
+	if( ! ParseArgs( argc, argv ) )
+		return 1;
+	if( MetricsOnExit )
+		atexit( ExportFrameTimes );
 
 	// setup all the graphics stuff:
 
@@ -294,14 +853,42 @@ main( int argc, char *argv[ ] )
 	// init all the global variables used by Display( ):
 
 	Reset( );
+	StartupMark( STARTUP_RESET );
 
 	// create the display structures that will not change:
 
+	InitJobs( );
+	InitOrbits( );
+	InitScene( );
+	InitMaterials( );
+	InitShading( );
+	InitDepth( );
+	InitRenderQueue( );
 	InitLists( );
+	StartupMark( STARTUP_LISTS );
+
+	InitEphemeris( );
+	InitSpk( );
+	StartupMark( STARTUP_EPHEMERIS );
+
+	InitAsteroids( );
+	StartupMark( STARTUP_ASTEROIDS );
+
+	InitComets( );
+	StartupMark( STARTUP_COMETS );
 
 	// setup all the user interface stuff:
 
 	InitMenus( );
+	StartupMark( STARTUP_MENUS );
+
+	// the benchmark takes over the animation:
+
+	if( BenchmarkOn != 0 )
+	{
+		BenchmarkStartPath( BenchPath );
+		glutIdleFunc( BenchmarkAnimate );
+	}
 
 	// draw the scene once and wait for some interaction:
 	// (this will never return)
@@ -334,6 +921,13 @@ Animate( )
 	ms %= MS_IN_THE_ANIMATION_CYCLE;				// milliseconds in the range 0 to MS_IN_THE_ANIMATION_CYCLE-1
 	Time = (float)ms / (float)MS_IN_THE_ANIMATION_CYCLE;        // [ 0., 1. )
 
+	// advance the simulation clock by the warped wall-clock time:
+
+	double now = NowMs( );
+	if( LastAnimateMs > 0. )
+		SimTime += ( now - LastAnimateMs ) * TimeWarp;
+	LastAnimateMs = now;
+
 	// force a call to Display( ) next time it is convenient:
 
 	glutSetWindow( MainWindow );
@@ -355,11 +949,41 @@ Display( )
 
 	glutSetWindow( MainWindow );
 
+	// collect the timings of the frames that have finished on the gpu:
+
+	ProfileFrameBegin( );
+	JobsResetStats( &Jobs );
+
+	// remember how long the last frame took and start counting this one:
+
+	double frameStart = NowMs( );
+	if( LastFrameStartMs > 0. )
+	{
+		FrameTimes[FrameTimeIndex] = (float)( frameStart - LastFrameStartMs );
+		FrameTimeIndex = ( FrameTimeIndex + 1 ) % HUD_GRAPH_FRAMES;
+		HistRecord( &FrameHist, frameStart - LastFrameStartMs );
+	}
+	LastFrameStartMs = frameStart;
+	DrawCalls = 0;
+	VerticesSubmitted = 0;
+
 	// erase the background:
 
 	glDrawBuffer( GL_BACK );
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
+	// the hud font is rendered into the back buffer once, so do it before the scene:
+
+	if( HudOn != 0  &&  GlyphAtlas == 0 )
+	{
+		InitGlyphAtlas( );
+		glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	}
+
+	// (reversed-Z draws the scene off screen, into a float depth buffer)
+
+	DepthBegin( &Depth, glutGet( GLUT_WINDOW_WIDTH ), glutGet( GLUT_WINDOW_HEIGHT ) );
+
 	glEnable( GL_DEPTH_TEST );
 #ifdef DEMO_DEPTH_BUFFER
 	if( DepthBufferOn == 0 )
@@ -378,43 +1002,74 @@ Display( )
 	GLint xl = ( vx - v ) / 2;
 	GLint yb = ( vy - v ) / 2;
 	glViewport( xl, yb,  v, v );
+	ViewportSize = v;
 
 	// set the viewing volume:
 	// remember that the Z clipping  values are actually
 	// given as DISTANCES IN FRONT OF THE EYE
 	// USE gluOrtho2D( ) IF YOU ARE DOING 2D !
 
-	glMatrixMode( GL_PROJECTION );
-	glLoadIdentity( );
-	if( WhichProjection == ORTHO )
-		glOrtho( -3., 3.,     -3., 3.,     0.1, 1000. );
-	else
-		gluPerspective( 60., 1.,	0.1, 1000. );
+	// (every matrix is made on the CPU, so it knows where everything is,
+	//  and handed to GL whole)
 
-	// place the objects into the scene:
+	// rotate the scene, about y then about x, as one quaternion:
 
-	glMatrixMode( GL_MODELVIEW );
-	glLoadIdentity( );
+	Quat qy, qx, q;
+	QuatAxisAngle( &qy, (float)Yrot, 0., 1., 0. );
+	QuatAxisAngle( &qx, (float)Xrot, 1., 0., 0. );
+	QuatMultiply( &qy, &qx, &q );
 
-	// set the eye position, look-at position, and up-vector:
+	if( Scale < MINSCALE )
+		Scale = MINSCALE;
 
-	gluLookAt( 0., 10., -120.,     0., 0., 0.,     0., 1., 0. );
+	if( TrueScaleOn != 0 )
+	{
+		// the eye among the bodies at their real sizes and distances:
+		TrueScaleView( &q );
+	}
+	else
+	{
+		if( WhichProjection == ORTHO )
+			DepthOrtho( &Depth, &Projection, -3., 3.,     -3., 3.,     0.1f, 1000. );
+		else
+			DepthPerspective( &Depth, &Projection, 60., 1.,	0.1f, 1000. );
+
+		// set the eye position, look-at position, and up-vector:
+
+		float eyePos[3] = { 0., 10., -120. };
+		float lookAt[3] = { 0., 0., 0. };
+		float up[3]     = { 0., 1., 0. };
+		Mat4 lookView;
+		Mat4LookAt( &lookView, eyePos, lookAt, up );
+
+		// rotate, then uniformly scale the scene:
+
+		Mat4 rotate, scale, rotated;
+		Mat4FromQuat( &rotate, &q );
+		Mat4Scale( &scale, (float)Scale );
+		Mat4Multiply( &lookView, &rotate, &rotated );
+		Mat4Multiply( &rotated, &scale, &View );
+	}
+	glMatrixMode( GL_PROJECTION );
+	glLoadMatrixf( Projection.m );
 
-	// rotate the scene:
+	// place the objects into the scene:
 
-	glRotatef( (GLfloat)Yrot, 0., 1., 0. );
-	glRotatef( (GLfloat)Xrot, 1., 0., 0. );
+	glMatrixMode( GL_MODELVIEW );
+	glLoadMatrixf( View.m );
 
-	// uniformly scale the scene:
+	// and what it can see, for culling:
 
-	if( Scale < MINSCALE )
-		Scale = MINSCALE;
-	glScalef( (GLfloat)Scale, (GLfloat)Scale, (GLfloat)Scale );
+	Mat4 viewProjection;
+	Mat4Multiply( &Projection, &View, &viewProjection );
+	Mat4FrustumPlanes( &viewProjection, FrustumPlanes );
+	ViewScale = sqrtf( Vec3Dot( &View.m[0], &View.m[0] ) );
+	ViewOrtho = Projection.m[11] == 0.;
 
 	// set the fog parameters:
 	// (this is really here to do intensity depth cueing)
 
-	if( DepthCueOn != 0 )
+	if( DepthCueOn != 0  &&  TrueScaleOn == 0 )
 	{
 		glFogi( GL_FOG_MODE, FOGMODE );
 		glFogfv( GL_FOG_COLOR, FOGCOLOR );
@@ -430,25 +1085,68 @@ Display( )
 
 	// possibly draw the axes:
 
-	if( AxesOn != 0 )
+	if( AxesOn != 0  &&  TrueScaleOn == 0 )
 	{
 		glColor3fv( &Colors[WhichColor][0] );
-		glCallList( AxesList );
+		CallList( AxesList );
 	}
 
-	// since we are using glScalef( ), be sure normals get unitized:
+	// since the view scales the scene, be sure normals get unitized:
 
 	glEnable( GL_NORMALIZE );
-	int ms = glutGet(GLUT_ELAPSED_TIME);
+
+	// where the planets are along their orbits:
+
+	if( GravityOn != 0 )
+	{
+		StepGravity( );
+		PositionSource = "gravity";
+	}
+	else if( SpkPlanets( SimTime ) )
+	{
+		PositionSource = "spk";
+	}
+	else if( EphemerisCovers( &PlanetEph, SimTime ) )
+	{
+		EphemerisEvaluate( &PlanetEph, SimTime, 0, NUMPLANETS, &PlanetPos[0][0] );
+		PositionSource = "ephemeris";
+	}
+	else
+	{
+		KeplerPropagate(&Model.planets, SimTime, 0, NUMPLANETS, &PlanetPos[0][0]);
+		PositionSource = "elements";
+	}
+	UpdateScene( );
+	if( TrueScaleOn != 0 )
+		PositionSource = "elements, true scale";
+	DrawScene = TrueScaleOn != 0 ? &Rebased : &Scene;
 
 
 	// Turn on the lights
+	// (the frame's lighting -- the Sun's point light and the ambient level --
+	//  is set up once as values, then handed whole to whichever path draws)
 	glEnable(GL_LIGHTING);
-	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, MulArray3(.3f, White));
-	glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);
+	float sunColor = Light0On ? 1.f : 0.f;
+	const float *sunAt = &DrawScene->world[SunNode].m[12];
+	PointLight sun = PointLightAt(sunAt[0], sunAt[1], sunAt[2], sunColor, sunColor, sunColor);
+	FrameLightingInit(&Lighting, &sun, .3f);
+
+	PerPixelNow = PerPixelOn != 0  &&  Shader.program != 0;
+	if( SphereSlices != SphereSlicesWanted( ) )
+		InitSphereLists( SphereSlicesWanted( ) );
+	if( PerPixelNow )
+	{
+		// one uniform buffer upload, the Sun taken to eye coordinates,
+		// with what shades each body from it:
+		float eye[3], sunRadius;
+		Mat4TransformPoint( &View, Lighting.sun.position, eye );
+		GatherShadows( &sunRadius );
+		ShadingSetFrame( &Shader, &Lighting, eye, sunRadius );
+	}
 
-	// Turn on the Sun's point light
-	SetPointLight(GL_LIGHT0, 0., 0., 0., 1., 1., 1.);
+	// fixed function gets the same lighting either way: even with per-pixel
+	// lighting, the sky box and the particles are drawn through it
+	LightingApply( &Lighting, GL_LIGHT0 );
 
 	if (Light0On) {
 		glEnable(GL_LIGHT0);
@@ -457,270 +1155,303 @@ Display( )
 		glDisable(GL_LIGHT0);
 	}
 	
-	// Temporarily turn of light to make Sun bright
-	glDisable(GL_LIGHTING);
+	// collect the Sun, the planets, the moons and the ring annulus, each
+	// with the state it needs, as jobs that leave out what is out of view,
+	// and sort them so that state is set least often:
+	RenderBegin(&Queue, PerPixelNow ? &Shader : NULL, Jobs.threads);
+	GatherOccluders();
+	QueueBodies( SimTime );
+	RenderSort(&Queue);
+	RenderTransform(&Queue, &View);
+
+	// Draw the Sun, unlit so it is bright
+	ProfileBegin(PASS_SUN);
+	RenderDraw(&Queue, PASS_SUN);
+	ProfileEnd(PASS_SUN);
+
+	// Draw the orbit paths of the planets
+	// (they, the asteroids, the comets and the ring particles are only in
+	//  the scene's units, so true scale leaves them out)
+	ProfileBegin(PASS_ORBITS);
+	if( TrueScaleOn == 0 )
+		for (int p = 0; p < NUMPLANETS; p++)
+			orbital_path(p);
+	ProfileEnd(PASS_ORBITS);
+
+	// Draw the planets
+	ProfileBegin(PASS_PLANETS);
+	RenderDraw(&Queue, PASS_PLANETS);
+	ProfileEnd(PASS_PLANETS);
+
+	// Draw the moons
+	ProfileBegin(PASS_MOONS);
+	RenderDraw(&Queue, PASS_MOONS);
+	ProfileEnd(PASS_MOONS);
 
-	// Draw the Sun
-	glPushMatrix();
+	// create the surrounding deep space
+	// (before what is drawn blended without writing depth -- the asteroids,
+	//  comets and rings -- which it would otherwise paint over)
+	ProfileBegin(PASS_SKYBOX);
 	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
+	MaterialApply(&WhiteMaterial);
 	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[0]);
-	int sun_rotation_period = 25379; //25.379 Earth days
-	glRotatef(360 * (float(ms % sun_rotation_period) / sun_rotation_period), 0., 1., 0.);
-	glCallList(Sun);
+	glBindTexture(GL_TEXTURE_2D, Tex[11]);
+	if( TrueScaleOn != 0 )
+	{
+		// the eye is at the origin: push the box out to just inside the far plane
+		Mat4 sky, skyView;
+		Mat4Scale(&sky, TrueSkyScale);
+		Mat4Multiply(&View, &sky, &skyView);
+		glLoadMatrixf(skyView.m);
+		DeepSpace();
+		glLoadMatrixf(View.m);
+	}
+	else
+		DeepSpace();
 	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
-
-	// Turn light back on for the rest of the planets
-	glEnable(GL_LIGHTING);
+	ProfileEnd(PASS_SKYBOX);
+
+	// Draw the asteroid belt
+	ProfileBegin(PASS_ASTEROIDS);
+	AsteroidsDrawn = 0;
+	if( AsteroidsOn != 0  &&  TrueScaleOn == 0 )
+		DrawAsteroids( );
+	if( GravityOn != 0  &&  TrueScaleOn == 0 )
+		DrawSwarm( );
+	ProfileEnd(PASS_ASTEROIDS);
+
+	// Draw the comets
+	ProfileBegin(PASS_COMETS);
+	CometParticlesDrawn = 0;
+	if( CometsOn != 0  &&  TrueScaleOn == 0 )
+		DrawComets( );
+	ProfileEnd(PASS_COMETS);
 
-	// Draw Mercury
-	glPushMatrix();
-	int mercury_orbital_period = int(orbital_period_scale_factor(4.979));
-	int mercury_rotation_period = 58646; // 58.646 Earth days
-	orbital_path(4.979);
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[1]);
-	glRotatef(360*(float(ms % mercury_orbital_period)/mercury_orbital_period), 0.,1.,0.);
-	glTranslatef(4.979, 0., 0.);
-	glRotatef(360 * (float(ms % mercury_rotation_period) / mercury_rotation_period), 0., 1., 0.);
-	glCallList(Mercury);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	// Draw Saturn's Rings
+	// (as particles when they are big enough on the screen for it to show,
+	//  otherwise as the textured annulus, which is in the queue)
+	ProfileBegin(PASS_RINGS);
+	RingParticlesDrawn = 0;
+	if( RingParticlesNow )
+	{
+		Mat4 ringView;
+		Mat4Multiply(&View, &RingFrame, &ringView);
+		glLoadMatrixf(ringView.m);
+		RingParticlesDrawn = DrawParticles( &Rings, RingBuffer, &RingXyz, NUMRINGPARTICLES, RING_POINT_SIZE,
+							0.80f, 0.72f, 0.58f );
+		glLoadMatrixf(View.m);
+	}
+	RenderDraw(&Queue, PASS_RINGS);
+	DrawCalls += Queue.drawCalls;
+	VerticesSubmitted += Queue.vertices;
+	ProfileEnd(PASS_RINGS);
 
+	// Turn off the lights
+	glDisable(GL_LIGHTING);
 
-	// Draw Venus
-	glPushMatrix();
-	int venus_orbital_period = int(orbital_period_scale_factor(5.830));
-	int venus_rotation_period = 243018; // -243.018 Earth days
-	orbital_path(5.830);
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[2]);
-	glRotatef(360 * (float(ms % venus_orbital_period) / venus_orbital_period), 0., 1., 0.);
-	glTranslatef(5.830, 0., 0.);
-	glRotatef(177.0, 0., 1., 0.);
-	glRotatef(-360 * (float(ms % venus_rotation_period) / venus_rotation_period), 0., 1., 0.);
-	glCallList(Venus);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	// back to the window for the hud:
+	DepthEnd(&Depth);
 
-	// Draw Earth
-	glPushMatrix();
-	int earth_orbital_period = int(orbital_period_scale_factor(6.529));
-	int earth_rotation_period = 997; //.997 days
-	orbital_path(6.529);
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[3]);
-	glRotatef(360 * (float(ms % earth_orbital_period) / earth_orbital_period), 0., 1., 0.);
-	glTranslatef(6.529, 0., 0.);
-	glRotatef(23.5, 0., 1., 0.);
-	glRotatef(360 * (float(ms % earth_rotation_period) / earth_rotation_period), 0., 1., 0.);
-	glCallList(Earth);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	// draw the performance hud over the scene:
 
-	// Draw Mars
-	glPushMatrix();
-	int mars_orbital_period = int(orbital_period_scale_factor(7.853));
-	int mars_rotation_period = 1026; //1.026 Earth days
-	orbital_path(7.853);
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[4]);
-	glRotatef(360 * (float(ms % mars_orbital_period) / mars_orbital_period), 0., 1., 0.);
-	glTranslatef(7.853, 0., 0.);
-	glRotatef(25.0, 0., 1., 0.);
-	glRotatef(360 * (float(ms % mars_rotation_period) / mars_rotation_period), 0., 1., 0.);
-	glCallList(Mars);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	if( HudOn != 0 )
+		DrawHud( );
 
-	// Draw Jupiter
-	glPushMatrix();
-	int jupiter_orbital_period = int(orbital_period_scale_factor(17.154));
-	int jupiter_rotation_period = 413.53; // 0.41353 Earth days
-	orbital_path(17.154);
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[5]);
-	glRotatef(360 * (float(ms % jupiter_orbital_period) / jupiter_orbital_period), 0., 1., 0.);
-	glTranslatef(17.154, 0., 0.);
-	glRotatef(3.0, 0., 1., 0.);
-	glRotatef(360 * (float(ms % jupiter_rotation_period) / jupiter_rotation_period), 0., 1., 0.);
-	glCallList(Jupiter);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	// swap the double-buffered framebuffers:
 
-	// Draw Saturn
-	glPushMatrix();
-	int saturn_orbital_period = int(orbital_period_scale_factor(28.127));
-	int saturn_rotation_period = 444.03; // 0.44403 Earth days
-	orbital_path(28.127);
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[6]);
-	glRotatef(360 * (float(ms % saturn_orbital_period) / saturn_orbital_period), 0., 1., 0.);
-	glTranslatef(28.127, 0., 0.);
-	glRotatef(27.0, 0., 1., 0.);
-	glRotatef(360 * (float(ms % saturn_rotation_period) / saturn_rotation_period), 0, 1, 0);
-	glCallList(Saturn);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	glutSwapBuffers( );
 
-	// Draw Saturn's Rings
-	glPushMatrix();
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[7]);
-	glRotatef(360 * (float(ms % saturn_orbital_period) / saturn_orbital_period), 0., 1., 0.);
-	glTranslatef(28.127, 0., 0.);
-	glRotatef(27.0, 0., 1., 0.);
-	glCallList(SaturnRings);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	// be sure the graphics buffer has been sent:
+	// note: be sure to use glFlush( ) here, not glFinish( ) !
 
-	// Draw Uranus
-	glPushMatrix();
-	int uranus_orbital_period = int(orbital_period_scale_factor(52.517));
-	int uranus_rotation_period = 718.33; // -0.71833 Earth days
-	orbital_path(52.517);
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[8]);
-	glRotatef(360 * (float(ms % uranus_orbital_period) / uranus_orbital_period), 0., 1., 0.);
-	glTranslatef(52.517, 0., 0.);
-	glRotatef(98.0, 0., 1., 0.);
-	glRotatef(-360 * (float(ms % uranus_rotation_period) / uranus_rotation_period), 0., 1., 0.);
-	glCallList(Uranus);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	glFlush( );
 
-	// Draw Neptune
-	glPushMatrix();
-	int neptune_orbital_period = int(orbital_period_scale_factor(80.026));
-	int neptune_rotation_period = 671.25; // 0.67125 Earth days
-	orbital_path(80.026);
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[9]);
-	glRotatef(360 * (float(ms % neptune_orbital_period) / neptune_orbital_period), 0., 1., 0.);
-	glTranslatef(80.026, 0., 0.);
-	glRotatef(30.0, 0., 1., 0.);
-	glRotatef(360 * (float(ms % neptune_rotation_period) / neptune_rotation_period), 0., 1., 0.);
-	glCallList(Neptune);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	ProfileFrameEnd( );
 
-	// Draw Pluto
-	glPushMatrix();
-	int pluto_orbital_period = int(orbital_period_scale_factor(104.));
-	int pluto_rotation_period = 6375; // 6.375 Earth days
-	orbital_path(104.);
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[10]);
-	glRotatef(360 * (float(ms % pluto_orbital_period) / pluto_orbital_period), 0., 1., 0.);
-	glTranslatef(104., 0., 0.);
-	glRotatef(118.0, 0., 1., 0.);
-	glRotatef(-360 * (float(ms % pluto_rotation_period) / pluto_rotation_period), 0., 1., 0.);
-	glCallList(Pluto);
-	glDisable(GL_TEXTURE_2D);
-	glPopMatrix();
+	// time-to-first-frame counts until the gpu has really finished it:
 
-	// create the surrounding deep space
-	glShadeModel(GL_SMOOTH);
-	SetMaterial(1.0, 1.0, 1.0, 20.0);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, Tex[11]);
-	DeepSpace();
-	glDisable(GL_TEXTURE_2D);
+	if( ! FirstFramePresented )
+	{
+		glFinish( );
+		StartupMark( STARTUP_FIRSTFRAME );
+		FirstFramePresented = true;
+		StartupReport( );
+		if( ColdStartOn != 0 )
+		{
+			glutDestroyWindow( MainWindow );
+			exit( 0 );
+		}
+	}
 
-	// Turn off the lights
-	glDisable(GL_LIGHTING);
+	if( BenchmarkOn != 0 )
+		BenchmarkFrameDone( );
+}
 
-	// swap the double-buffered framebuffers:
 
-	glutSwapBuffers( );
+void
+DoAsteroidsMenu( int id )
+{
+	AsteroidsOn = id;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
 
-	// be sure the graphics buffer has been sent:
-	// note: be sure to use glFlush( ) here, not glFinish( ) !
 
-	glFlush( );
+void
+DoLightingMenu( int id )
+{
+	PerPixelOn = id;
+	if( PerPixelOn != 0  &&  Shader.program == 0 )
+		fprintf( stderr, "Per-pixel lighting is not available -- staying with fixed function\n" );
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
 }
 
 
 void
-DoAxesMenu( int id )
+DoStateCacheMenu( int id )
 {
-	AxesOn = id;
+	Queue.cache.filter = id != 0;
 	glutSetWindow( MainWindow );
 	glutPostRedisplay( );
 }
 
 
 void
-DoColorMenu( int id )
+DoTrueScaleMenu( int id )
 {
-	WhichColor = id - RED;
+	// start at the Earth rather than flying there from wherever the eye was:
+	if( id != 0  &&  TrueScaleOn == 0 )
+		TrueCameraInit( &TrueEye );
+	TrueScaleOn = id;
 	glutSetWindow( MainWindow );
 	glutPostRedisplay( );
 }
 
 
 void
-DoDebugMenu( int id )
+DoShadowsMenu( int id )
 {
-	DebugOn = id;
+	ShadowsOn = id;
 	glutSetWindow( MainWindow );
 	glutPostRedisplay( );
 }
 
 
 void
-DoDepthBufferMenu( int id )
+DoOcclusionMenu( int id )
 {
-	DepthBufferOn = id;
+	OcclusionOn = id;
 	glutSetWindow( MainWindow );
 	glutPostRedisplay( );
 }
 
 
 void
-DoDepthFightingMenu( int id )
+DoJobsMenu( int id )
 {
-	DepthFightingOn = id;
+	Jobs.enabled = id != 0;
 	glutSetWindow( MainWindow );
 	glutPostRedisplay( );
 }
 
 
 void
-DoDepthMenu( int id )
+DoCometsMenu( int id )
 {
-	DepthCueOn = id;
+	CometsOn = id;
 	glutSetWindow( MainWindow );
 	glutPostRedisplay( );
 }
 
 
-// main menu callback:
-
 void
-DoMainMenu( int id )
+DoRingsMenu( int id )
+{
+	RingParticlesOn = id;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+void
+DoGravityMenu( int id )
+{
+	GravityOn = id;
+	if( GravityOn != 0 )
+		InitGravity( );
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+void
+DoAxesMenu( int id )
+{
+	AxesOn = id;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+void
+DoColorMenu( int id )
+{
+	WhichColor = id - RED;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+void
+DoDebugMenu( int id )
+{
+	DebugOn = id;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+void
+DoDepthBufferMenu( int id )
+{
+	DepthBufferOn = id;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+void
+DoDepthFightingMenu( int id )
+{
+	DepthFightingOn = id;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+void
+DoDepthMenu( int id )
+{
+	DepthCueOn = id;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+void
+DoHudMenu( int id )
+{
+	HudOn = id;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+// main menu callback:
+
+void
+DoMainMenu( int id )
 {
 	switch( id )
 	{
@@ -747,6 +1478,16 @@ DoMainMenu( int id )
 }
 
 
+void
+DoProfileMenu( int id )
+{
+	ProfileOn = id;
+	ProfileResetCounters( );
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
 void
 DoProjectMenu( int id )
 {
@@ -801,6 +1542,17 @@ ElapsedSeconds( )
 }
 
 
+// return the number of milliseconds since an arbitrary fixed point,
+// with sub-millisecond resolution (GLUT_ELAPSED_TIME is too coarse to time a pass):
+
+double
+NowMs( )
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>( steady_clock::now( ).time_since_epoch( ) ).count( );
+}
+
+
 // initialize the glui window:
 
 void
@@ -835,13 +1587,63 @@ InitMenus( )
 	glutAddMenuEntry( "Off",  0 );
 	glutAddMenuEntry( "On",   1 );
 
+	int asteroidsmenu = glutCreateMenu( DoAsteroidsMenu );
+	glutAddMenuEntry( "Off",  0 );
+	glutAddMenuEntry( "On",   1 );
+
+	int lightingmenu = glutCreateMenu( DoLightingMenu );
+	glutAddMenuEntry( "Fixed function",  0 );
+	glutAddMenuEntry( "Per-pixel",       1 );
+
+	int statecachemenu = glutCreateMenu( DoStateCacheMenu );
+	glutAddMenuEntry( "Off",  0 );
+	glutAddMenuEntry( "On",   1 );
+
+	int truescalemenu = glutCreateMenu( DoTrueScaleMenu );
+	glutAddMenuEntry( "Scene",        0 );
+	glutAddMenuEntry( "True scale",   1 );
+
+	int shadowsmenu = glutCreateMenu( DoShadowsMenu );
+	glutAddMenuEntry( "Off",  0 );
+	glutAddMenuEntry( "On",   1 );
+
+	int occlusionmenu = glutCreateMenu( DoOcclusionMenu );
+	glutAddMenuEntry( "Off",  0 );
+	glutAddMenuEntry( "On",   1 );
+
+	int jobsmenu = glutCreateMenu( DoJobsMenu );
+	glutAddMenuEntry( "GL thread only",  0 );
+	glutAddMenuEntry( "All threads",     1 );
+
+	int cometsmenu = glutCreateMenu( DoCometsMenu );
+	glutAddMenuEntry( "Off",  0 );
+	glutAddMenuEntry( "On",   1 );
+
+	int gravitymenu = glutCreateMenu( DoGravityMenu );
+	glutAddMenuEntry( "Off",  0 );
+	glutAddMenuEntry( "On",   1 );
+
+	int hudmenu = glutCreateMenu( DoHudMenu );
+	glutAddMenuEntry( "Off",  0 );
+	glutAddMenuEntry( "On",   1 );
+
+	int profilemenu = glutCreateMenu( DoProfileMenu );
+	glutAddMenuEntry( "Off",  0 );
+	glutAddMenuEntry( "On",   1 );
+
+	int ringsmenu = glutCreateMenu( DoRingsMenu );
+	glutAddMenuEntry( "Annulus only",  0 );
+	glutAddMenuEntry( "Particles",     1 );
+
 	int projmenu = glutCreateMenu( DoProjectMenu );
 	glutAddMenuEntry( "Orthographic",  ORTHO );
 	glutAddMenuEntry( "Perspective",   PERSP );
 
 	int mainmenu = glutCreateMenu( DoMainMenu );
 	glutAddSubMenu(   "Axes",          axesmenu);
+	glutAddSubMenu(   "Asteroids",     asteroidsmenu);
 	glutAddSubMenu(   "Colors",        colormenu);
+	glutAddSubMenu(   "Comets",        cometsmenu);
 
 #ifdef DEMO_DEPTH_BUFFER
 	glutAddSubMenu(   "Depth Buffer",  depthbuffermenu);
@@ -852,9 +1654,19 @@ InitMenus( )
 #endif
 
 	glutAddSubMenu(   "Depth Cue",     depthcuemenu);
+	glutAddSubMenu(   "Gravity",       gravitymenu );
 	glutAddSubMenu(   "Projection",    projmenu );
+	glutAddSubMenu(   "Rings",         ringsmenu );
+	glutAddSubMenu(   "Scale",         truescalemenu );
+	glutAddSubMenu(   "HUD",           hudmenu );
+	glutAddSubMenu(   "Jobs",          jobsmenu );
+	glutAddSubMenu(   "Occlusion",     occlusionmenu );
+	glutAddSubMenu(   "Lighting",      lightingmenu );
+	glutAddSubMenu(   "Shadows",       shadowsmenu );
 	glutAddMenuEntry( "Reset",         RESET );
 	glutAddSubMenu(   "Debug",         debugmenu);
+	glutAddSubMenu(   "Profiler",      profilemenu);
+	glutAddSubMenu(   "State Cache",   statecachemenu);
 	glutAddMenuEntry( "Quit",          QUIT );
 
 // attach the pop-up menu to the right mouse button:
@@ -934,6 +1746,7 @@ InitGraphics( )
 	glutMenuStateFunc( NULL );
 	glutTimerFunc( -1, NULL, 0 );
 	glutIdleFunc( Animate );
+	StartupMark( STARTUP_WINDOW );
 
 	for (int i = 0; i < 12; i++) {
 		if (i < 11) {
@@ -959,13 +1772,29 @@ InitGraphics( )
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 		
-		glTexImage2D(GL_TEXTURE_2D, level, ncomps, width, height, border, GL_RGB, GL_UNSIGNED_BYTE, Texture[i]);
+		// (a missing file leaves Texture[i] NULL, and the texture blank)
+		if (i == RINGS_TEXTURE && Texture[i] != NULL) {
+			std::vector<unsigned char> rgba(4 * width * height);
+			for (int t = 0; t < width * height; t++) {
+				const unsigned char *rgb = &Texture[i][3 * t];
+				rgba[4 * t + 0] = rgb[0];
+				rgba[4 * t + 1] = rgb[1];
+				rgba[4 * t + 2] = rgb[2];
+				rgba[4 * t + 3] = std::max(rgb[0], std::max(rgb[1], rgb[2]));
+			}
+			ncomps = 4;
+			glTexImage2D(GL_TEXTURE_2D, level, ncomps, width, height, border, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+		}
+		else
+			glTexImage2D(GL_TEXTURE_2D, level, ncomps, width, height, border, GL_RGB, GL_UNSIGNED_BYTE, Texture[i]);
+		TextureBytes += (long)width * height * ncomps;
 	}
+	StartupMark( STARTUP_TEXTURES );
 
 
 	// init glew (a window must be open to do this):
+	// (needed on every platform, the gpu timer queries are not in opengl 1.1)
 
-#ifdef WIN32
 	GLenum err = glewInit( );
 	if( err != GLEW_OK )
 	{
@@ -974,7 +1803,9 @@ InitGraphics( )
 	else
 		fprintf( stderr, "GLEW initialized OK\n" );
 	fprintf( stderr, "Status: Using GLEW %s\n", glewGetString(GLEW_VERSION));
-#endif
+
+	InitProfiler( );
+	StartupMark( STARTUP_GLEW );
 }
 
 
@@ -990,60 +1821,13 @@ InitLists( )
 
 	// create Sun and planets display lists
 
-	Sun = glGenLists(1);
-	glNewList(Sun, GL_COMPILE);
-	OsuSphere(4.0, 50, 50);
-	glEndList();
-
-	Mercury = glGenLists(1);
-	glNewList(Mercury, GL_COMPILE);
-	OsuSphere(0.131, 50, 50);
-	glEndList();
-
-	Venus = glGenLists(1);
-	glNewList(Venus, GL_COMPILE);
-	OsuSphere(0.325, 50, 50);
-	glEndList();
-
-	Earth = glGenLists(1);
-	glNewList(Earth, GL_COMPILE);
-	OsuSphere(0.342, 50, 50);
-	glEndList();
-
-	Mars = glGenLists(1);
-	glNewList(Mars, GL_COMPILE);
-	OsuSphere(0.182, 50, 50);
-	glEndList();
-
-	Jupiter = glGenLists(1);
-	glNewList(Jupiter, GL_COMPILE);
-	OsuSphere(3.75, 50, 50);
-	glEndList();
-
-	Saturn = glGenLists(1);
-	glNewList(Saturn, GL_COMPILE);
-	OsuSphere(3.124, 50, 50);
-	glEndList();
+	InitSphereLists( SphereSlicesWanted( ) );
 
 	SaturnRings = glGenLists(1);
 	glNewList(SaturnRings, GL_COMPILE);
 	saturn_rings(3.5, 4.5);
 	glEndList();
-
-	Uranus = glGenLists(1);
-	glNewList(Uranus, GL_COMPILE);
-	OsuSphere(1.360, 50, 50);
-	glEndList();
-
-	Neptune = glGenLists(1);
-	glNewList(Neptune, GL_COMPILE);
-	OsuSphere(1.321, 50, 50);
-	glEndList();
-
-	Pluto = glGenLists(1);
-	glNewList(Pluto, GL_COMPILE);
-	OsuSphere(0.127, 50, 50);
-	glEndList();
+	RecordListVertices(SaturnRings);
 
 	// create the axes:
 
@@ -1053,6 +1837,45 @@ InitLists( )
 			Axes( 1.5 );
 		glLineWidth( 1. );
 	glEndList( );
+	RecordListVertices( AxesList );
+}
+
+
+// (re)build the Sun's, planets' and moons' sphere lists with this many
+// slices and stacks:
+// (per-pixel lighting does not need the fine tessellation that Gouraud
+//  shading does, so switching lighting paths rebuilds them)
+
+void
+SphereList( GLuint *list, float radius, int slices )
+{
+	if( *list == 0 )
+		*list = glGenLists(1);
+	glNewList(*list, GL_COMPILE);
+	OsuSphere(radius, slices, slices);
+	glEndList();
+	RecordListVertices(*list);
+}
+
+
+void
+InitSphereLists( int slices )
+{
+	GLuint *planetLists[NUMPLANETS] = { &Mercury, &Venus, &Earth, &Mars, &Jupiter, &Saturn, &Uranus, &Neptune, &Pluto };
+	SphereList(&Sun, SUN_RADIUS, slices);
+	for (int p = 0; p < NUMPLANETS; p++)
+		SphereList(planetLists[p], PlanetLooks[p].radius, slices);
+	SphereList(&MoonSphere, 1.0, slices < MOON_SLICES ? slices : MOON_SLICES);
+	SphereSlices = slices;
+}
+
+
+// how finely the spheres should be tessellated for the lighting in use:
+
+int
+SphereSlicesWanted( )
+{
+	return PerPixelOn != 0  &&  Shader.program != 0 ? SPHERE_SLICES_PERPIXEL : SPHERE_SLICES;
 }
 
 
@@ -1072,13 +1895,71 @@ Keyboard( unsigned char c, int x, int y )
 
 		case 'f':
 		case 'F':
+			if( BenchmarkOn != 0 )
+				break;		// the benchmark owns the animation
 			Frozen = !Frozen;
+			LastAnimateMs = 0.;
+			LastFrameStartMs = 0.;		// don't count the pause as a frame
 			if (Frozen)
 				glutIdleFunc(NULL);
 			else
 				glutIdleFunc(Animate);
 			break;
 
+		case 'a':
+		case 'A':
+			DoAsteroidsMenu( ! AsteroidsOn );
+			break;
+
+		case 'c':
+		case 'C':
+			DoCometsMenu( ! CometsOn );
+			break;
+
+		case 'e':
+		case 'E':
+			ExportFrameTimes( );
+			break;
+
+		case 'r':
+		case 'R':
+			DoRingsMenu( ! RingParticlesOn );
+			break;
+
+		case 'g':
+		case 'G':
+			DoGravityMenu( ! GravityOn );
+			break;
+
+		case 'h':
+		case 'H':
+			DoHudMenu( ! HudOn );
+			break;
+
+		case '+':
+		case '=':
+			TimeWarp *= 2.f;
+			if( TimeWarp > MAXTIMEWARP )
+				TimeWarp = MAXTIMEWARP;
+			break;
+
+		case '-':
+		case '_':
+			TimeWarp /= 2.f;
+			if( TimeWarp < MINTIMEWARP )
+				TimeWarp = MINTIMEWARP;
+			break;
+
+		case 'j':
+		case 'J':
+			DoJobsMenu( ! Jobs.enabled );
+			break;
+
+		case 'l':
+		case 'L':
+			DoLightingMenu( ! PerPixelOn );
+			break;
+
 		case 'o':
 		case 'O':
 			WhichProjection = ORTHO;
@@ -1089,6 +1970,34 @@ Keyboard( unsigned char c, int x, int y )
 			WhichProjection = PERSP;
 			break;
 
+		case 's':
+		case 'S':
+			DoTrueScaleMenu( ! TrueScaleOn );
+			break;
+
+		case '[':
+			TrueCameraFocus( &TrueEye, ( TrueEye.focus + NUMTRUEBODIES - 1 ) % NUMTRUEBODIES, NowMs( ) );
+			break;
+
+		case ']':
+			TrueCameraFocus( &TrueEye, ( TrueEye.focus + 1 ) % NUMTRUEBODIES, NowMs( ) );
+			break;
+
+		case 't':
+		case 'T':
+			DoProfileMenu( ! ProfileOn );
+			break;
+
+		case 'v':
+		case 'V':
+			DoOcclusionMenu( ! OcclusionOn );
+			break;
+
+		case 'w':
+		case 'W':
+			DoShadowsMenu( ! ShadowsOn );
+			break;
+
 		case 'q':
 		case 'Q':
 		case ESCAPE:
@@ -1210,8 +2119,20 @@ void
 Reset( )
 {
 	ActiveButton = 0;
+	AsteroidsOn = 1;
+	CometsOn = 1;
+	PerPixelOn = 1;
+	RingParticlesOn = 1;
+	TrueScaleOn = 0;
+	TrueCameraInit( &TrueEye );
+	OcclusionOn = 1;
+	ShadowsOn = 1;
 	AxesOn = 1;
 	DebugOn = 0;
+	GravityOn = 0;
+	HudOn = 0;
+	ProfileOn = 0;
+	TimeWarp = 1.;
 	DepthBufferOn = 1;
 	DepthFightingOn = 0;
 	DepthCueOn = 0;
@@ -1375,6 +2296,8 @@ Axes( float length )
 		}
 	glEnd( );
 
+	ListVertexCount += 3 + 2 + 4 + 5 + 6;		// for the hud
+
 }
 
 // read a BMP file into a Texture:
@@ -1428,7 +2351,7 @@ BmpToTexture( char *filename, int *width, int *height )
 		return NULL;
         }
 #else
-	FILE *fp = fopen( filename, "rb" );
+	fp = fopen( filename, "rb" );
 	if( fp == NULL )
 	{
 		fprintf( stderr, "Cannot open Bmp file '%s'\n", filename );
@@ -1690,44 +2613,6 @@ HsvRgb( float hsv[3], float rgb[3] )
 	rgb[2] = b;
 }
 
-void
-Cross(float v1[3], float v2[3], float vout[3])
-{
-	float tmp[3];
-	tmp[0] = v1[1] * v2[2] - v2[1] * v1[2];
-	tmp[1] = v2[0] * v1[2] - v1[0] * v2[2];
-	tmp[2] = v1[0] * v2[1] - v2[0] * v1[1];
-	vout[0] = tmp[0];
-	vout[1] = tmp[1];
-	vout[2] = tmp[2];
-}
-
-float
-Dot(float v1[3], float v2[3])
-{
-	return v1[0] * v2[0] + v1[1] * v2[1] + v1[2] * v2[2];
-}
-
-float
-Unit(float vin[3], float vout[3])
-{
-	float dist = vin[0] * vin[0] + vin[1] * vin[1] + vin[2] * vin[2];
-	if (dist > 0.0)
-	{
-		dist = sqrtf(dist);
-		vout[0] = vin[0] / dist;
-		vout[1] = vin[1] / dist;
-		vout[2] = vin[2] / dist;
-	}
-	else
-	{
-		vout[0] = vin[0];
-		vout[1] = vin[1];
-		vout[2] = vin[2];
-	}
-	return dist;
-}
-
 /////// Sphere generation structs and functions below /////////
 
 struct point
@@ -1755,6 +2640,7 @@ DrawPoint(struct point* p)
 	glNormal3fv(&p->nx);
 	glTexCoord2fv(&p->s);
 	glVertex3fv(&p->x);
+	ListVertexCount++;
 }
 
 void
@@ -1860,82 +2746,204 @@ OsuSphere(float radius, int slices, int stacks)
 
 ///// Lighting functions
 
+// the materials are plain values, made once and shared by both lighting paths:
+
+void
+InitMaterials( )
+{
+	WhiteMaterial = MaterialColored( 1., 1., 1., 20. );
+	for( int m = 0; m < NUMMOONS; m++ )
+		MoonMaterial[m] = MaterialColored( Moons[m].color[0], Moons[m].color[1], Moons[m].color[2], 5. );
+}
+
+
+// set up the planets' and moons' orbits from their elements:
+
+void InitOrbits() {
+	SolarModelInit(&Model);
+}
+
+
+// the model the ephemeris tables are fitted to:
+
+void
+PlanetSource( void *data, int planet, double t, double xyz[3] )
+{
+	float f[3];
+	KeplerPropagate( (const KeplerSet *)data, t, planet, 1, f );
+	xyz[0] = f[0];
+	xyz[1] = f[1];
+	xyz[2] = f[2];
+}
+
+
+// load the planets' ephemeris tables from EphemerisFile, or fit them and save
+// them there:
+// (a file that does not match the current elements at points spread across
+// its whole span is stale -- matching at the start alone would miss, say, a
+// changed period)
+
 void
-SetMaterial(float r, float g, float b, float shininess)
+InitEphemeris( )
 {
-	glMaterialfv(GL_BACK, GL_EMISSION, Array3(0., 0., 0.));
-	glMaterialfv(GL_BACK, GL_AMBIENT, MulArray3(.4f, White));
-	glMaterialfv(GL_BACK, GL_DIFFUSE, MulArray3(1., White));
-	glMaterialfv(GL_BACK, GL_SPECULAR, Array3(0., 0., 0.));
-	glMaterialf(GL_BACK, GL_SHININESS, 5.f);
+	if( EphemerisFile != NULL  &&  EphemerisLoad( &PlanetEph, EphemerisFile, NUMPLANETS ) )
+	{
+		bool fresh = PlanetEph.t0 <= 0.;
+		for( int k = 0; fresh  &&  k <= EPHEMERIS_SAMPLES; k++ )
+		{
+			double t = PlanetEph.t0 + ( PlanetEph.t1 - PlanetEph.t0 ) * k / EPHEMERIS_SAMPLES;
+			for( int p = 0; fresh  &&  p < NUMPLANETS; p++ )
+			{
+				double truth[3];
+				float fit[3];
+				PlanetSource( &Model.planets, p, t, truth );
+				EphemerisEvaluate( &PlanetEph, t, p, 1, fit );
+				for( int axis = 0; axis < 3; axis++ )
+					fresh = fresh  &&  fabs( fit[axis] - truth[axis] ) < EPHEMERIS_STALE + PlanetEph.maxError;
+			}
+		}
+		if( fresh )
+			return;
+		fprintf( stderr, "Ephemeris file '%s' is stale, refitting\n", EphemerisFile );
+	}
 
-	glMaterialfv(GL_FRONT, GL_EMISSION, Array3(0., 0., 0.));
-	glMaterialfv(GL_FRONT, GL_AMBIENT, Array3(r, g, b));
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, Array3(r, g, b));
-	glMaterialfv(GL_FRONT, GL_SPECULAR, MulArray3(.8f, White));
-	glMaterialf(GL_FRONT, GL_SHININESS, shininess);
+	double periods[NUMPLANETS];
+	for( int p = 0; p < NUMPLANETS; p++ )
+		periods[p] = orbital_period_scale_factor( PlanetOrbits[p].a );
+	EphemerisFit( &PlanetEph, NUMPLANETS, periods, EPHEMERIS_PER_ORBIT, EPHEMERIS_DEGREE,
+		0., EPHEMERIS_YEARS * periods[EARTH], PlanetSource, &Model.planets );
+	if( DebugOn )
+		fprintf( stderr, "Ephemeris: %d KB, max error %.2e\n",
+			(int)( PlanetEph.coef.size( ) * sizeof(float) / 1024 ), PlanetEph.maxError );
+
+	if( EphemerisFile != NULL )
+		EphemerisSave( &PlanetEph, EphemerisFile );
 }
 
 
+// map the SPK kernel, if one was given:
+// (nothing of it is read here beyond its segment list)
+
 void
-SetPointLight(int ilight, float x, float y, float z, float r, float g, float b)
+InitSpk( )
 {
-	glLightfv(ilight, GL_POSITION, Array3(x, y, z));
-	glLightfv(ilight, GL_AMBIENT, Array3(0., 0., 0.));
-	glLightfv(ilight, GL_DIFFUSE, Array3(r, g, b));
-	glLightfv(ilight, GL_SPECULAR, Array3(r, g, b));
-	glLightf(ilight, GL_CONSTANT_ATTENUATION, 1.);
-	glLightf(ilight, GL_LINEAR_ATTENUATION, 0.);
-	glLightf(ilight, GL_QUADRATIC_ATTENUATION, 0.);
-	glEnable(ilight);
+	if( SpkFileName == NULL  ||  ! SpkOpen( &Kernel, SpkFileName ) )
+		return;
+
+	if( ! SpkCovers( &Kernel, SPK_SUN, 0. ) )
+		fprintf( stderr, "SPK kernel '%s' does not cover J2000, the planets will follow their elements\n",
+			SpkFileName );
 }
 
 
-float*
-Array3(float a, float b, float c)
+// the planets' real positions at simulation time t, if the kernel covers it:
+// (J2000 equatorial is turned to ecliptic and then to scene coordinates)
+
+bool
+SpkPlanets( double t )
 {
-	static float array[4];
+	if( Kernel.base == NULL )
+		return false;
+
+	double et = t / orbital_period_scale_factor( PlanetOrbits[EARTH].a ) * SPK_SECONDS_PER_YEAR;
+	double ce = cos( SPK_OBLIQUITY * M_PI / 180. );
+	double se = sin( SPK_OBLIQUITY * M_PI / 180. );
+	double sun[3];
+	if( ! SpkPosition( &Kernel, SPK_SUN, SPK_SSB, et, sun ) )
+		return false;
+
+	float pos[NUMPLANETS][3];
+	for( int p = 0; p < NUMPLANETS; p++ )
+	{
+		double eq[3];
+		if( ! SpkPosition( &Kernel, PlanetSpkIds[p], SPK_SSB, et, eq ) )
+			return false;
+		eq[0] -= sun[0];
+		eq[1] -= sun[1];
+		eq[2] -= sun[2];
+		double ecl[3] = { eq[0], ce * eq[1] + se * eq[2], -se * eq[1] + ce * eq[2] };
+		double scale = PlanetOrbits[p].a / ( PlanetAu[p] * SPK_KM_PER_AU );
+		pos[p][0] = (float)(  scale * ecl[0] );
+		pos[p][1] = (float)(  scale * ecl[2] );
+		pos[p][2] = (float)( -scale * ecl[1] );
+	}
+	memcpy( PlanetPos, pos, sizeof(pos) );
+	return true;
+}
 
-	array[0] = a;
-	array[1] = b;
-	array[2] = c;
-	array[3] = 1.;
-	return array;
+
+// build the scene graph: the Sun at the root, the planets under it, and each
+// moon under its planet, with the moons' orbits in their own Kepler set:
+
+void
+InitScene( )
+{
+	SceneInit( &Scene );
+	SunNode = SceneAdd( &Scene, -1 );
+	for( int p = 0; p < NUMPLANETS; p++ )
+		PlanetNodes[p] = SceneAdd( &Scene, SunNode );
+	for( int m = 0; m < NUMMOONS; m++ )
+		MoonNodes[m] = SceneAdd( &Scene, PlanetNodes[Moons[m].planet] );
+	MoonPos.resize( 3 * NUMMOONS );
+
+	// true scale draws the same nodes, each placed straight relative to the
+	// eye -- going through the parents would add and subtract floats of
+	// billions of km:
+	SceneInit( &Rebased );
+	for( int n = 0; n < (int)Scene.parent.size( ); n++ )
+		SceneAdd( &Rebased, -1 );
+	DrawScene = &Scene;
 }
 
-float*
-MulArray3(float factor, float array0[3])
+
+// move the planets' and moons' nodes to this frame's positions and bring the
+// world matrices up to date:
+// (PlanetPos must already be set)
+
+void
+UpdateScene( )
 {
-	static float array[4];
+	for( int p = 0; p < NUMPLANETS; p++ )
+		SceneSetTranslation( &Scene, PlanetNodes[p], PlanetPos[p][0], PlanetPos[p][1], PlanetPos[p][2] );
+
+	JobsRun( &Jobs, PropagateMoons, NULL, NUMMOONS, MOON_JOB_SIZE );
+	for( int m = 0; m < NUMMOONS; m++ )
+		SceneSetTranslation( &Scene, MoonNodes[m], MoonPos[3*m+0], MoonPos[3*m+1], MoonPos[3*m+2] );
 
-	array[0] = factor * array0[0];
-	array[1] = factor * array0[1];
-	array[2] = factor * array0[2];
-	array[3] = 1.;
-	return array;
+	SceneUpdate( &Scene );
 }
 
 
-void orbital_path(float radius) {
+// one job's moons, to this frame's positions:
+
+void
+PropagateMoons( void *, int first, int count, int )
+{
+	KeplerPropagate( &Model.moons, SimTime, first, count, &MoonPos[3*first] );
+}
+
+
+// draw a planet's orbit, stepping evenly around the ellipse in eccentric anomaly:
+
+void orbital_path(int planet) {
+	DrawCalls++;
+	VerticesSubmitted += 100;
 	glColor3f(0.1, 0.1, 0.1);
 	float dang = 2. * M_PI / 99.0;
 	float ang = 0;
 	glBegin(GL_LINE_LOOP);
 	for (int i = 0; i < 100; i++) {
-
-		glVertex3f(radius * cos(ang), 0., radius * sin(ang));
-		glNormal3f(-cos(ang), 0, -sin(ang));
+		float xyz[3];
+		KeplerPositionAt(&Model.planets, planet, ang, xyz);
+		float len = sqrtf(xyz[0] * xyz[0] + xyz[1] * xyz[1] + xyz[2] * xyz[2]);
+		glVertex3fv(xyz);
+		glNormal3f(-xyz[0] / len, -xyz[1] / len, -xyz[2] / len);
 		ang += dang;
 	}
 	glEnd();
 }
 
 
-float orbital_period_scale_factor(float t) {
-	return 500 * sqrt(t * t * t);
-}
-
-
 void saturn_rings(float radius1, float radius2) {
 	float dang = 2. * M_PI / 49.0;
 	float ang = 0;
@@ -1955,6 +2963,7 @@ void saturn_rings(float radius1, float radius2) {
 		glNormal3f(0., 1., 0.);
 		glTexCoord2f(1, 1);
 		glVertex3f(radius1 * cos(ang + dang), 0., radius1 * sin(ang + dang));
+		ListVertexCount += 4;
 
 		ang += dang;
 	}
@@ -1965,6 +2974,8 @@ void saturn_rings(float radius1, float radius2) {
 // creates the distant surrounding stars
 void DeepSpace() {
 	int dx = 150., dy = 150., dz = 150.;
+	DrawCalls++;
+	VerticesSubmitted += 24;
 
 	glBegin(GL_QUADS);
 
@@ -2032,4 +3043,1732 @@ void DeepSpace() {
 	glVertex3f(dx, -dy, dz);
 
 	glEnd();
-}
\ No newline at end of file
+}
+
+
+///// Profiler functions
+//
+// each pass of Display( ) is bracketed by ProfileBegin( )/ProfileEnd( ), which
+// accumulate the cpu time spent issuing the pass and wrap it in a GL_TIME_ELAPSED
+// query. the queries live in a ring of NUMQUERYFRAMES frames; a slot is only
+// read back when the ring comes around to it again, so we never wait on the gpu.
+
+void
+InitProfiler( )
+{
+	GpuTimersOn = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+	if( GpuTimersOn )
+		glGenQueries( NUMQUERYFRAMES * NUMPASSES, &PassQueries[0][0] );
+	else
+		fprintf( stderr, "GL_TIME_ELAPSED queries are not supported -- profiling the cpu only\n" );
+	ProfileResetCounters( );
+}
+
+
+void
+ProfileResetCounters( )
+{
+	for( int p = 0; p < NUMPASSES; p++ )
+	{
+		PassCpuMs[p] = 0.;
+		PassGpuMs[p] = 0.;
+		PassGpuSamples[p] = 0;
+	}
+	FrameCpuMs = 0.;
+	ProfileFrames = 0;
+	QueriesDropped = 0;
+}
+
+
+void
+ProfileFrameBegin( )
+{
+	FrameStartMs = NowMs( );
+
+	if( ! GpuTimersOn )
+		return;
+
+	// the queries in this slot were issued NUMQUERYFRAMES frames ago:
+
+	int slot = QueryFrame % NUMQUERYFRAMES;
+	for( int p = 0; p < NUMPASSES; p++ )
+	{
+		if( ! PassQueryPending[slot][p] )
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv( PassQueries[slot][p], GL_QUERY_RESULT_AVAILABLE, &available );
+		if( available )
+		{
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v( PassQueries[slot][p], GL_QUERY_RESULT, &ns );
+			PassGpuMs[p] += (double)ns / 1000000.;
+			PassGpuSamples[p]++;
+		}
+		else
+		{
+			// the gpu is more than NUMQUERYFRAMES behind -- drop it rather than wait:
+			QueriesDropped++;
+		}
+		PassQueryPending[slot][p] = false;
+	}
+}
+
+
+void
+ProfileBegin( int pass )
+{
+	if( ProfileOn == 0 )
+		return;
+
+	PassStartMs[pass] = NowMs( );
+	if( GpuTimersOn )
+		glBeginQuery( GL_TIME_ELAPSED, PassQueries[QueryFrame % NUMQUERYFRAMES][pass] );
+}
+
+
+void
+ProfileEnd( int pass )
+{
+	if( ProfileOn == 0 )
+		return;
+
+	if( GpuTimersOn )
+	{
+		glEndQuery( GL_TIME_ELAPSED );
+		PassQueryPending[QueryFrame % NUMQUERYFRAMES][pass] = true;
+	}
+	PassCpuMs[pass] += NowMs( ) - PassStartMs[pass];
+}
+
+
+void
+ProfileFrameEnd( )
+{
+	QueryFrame++;
+	if( ProfileOn == 0 )
+		return;
+
+	FrameCpuMs += NowMs( ) - FrameStartMs;
+	ProfileFrames++;
+	if( ProfileFrames >= PROFILE_REPORT_FRAMES )
+	{
+		ProfileReport( );
+		ProfileResetCounters( );
+	}
+}
+
+
+// print the averages since the last report:
+// (cpu times are the cost of issuing the calls, gpu times are the cost of executing them)
+
+void
+ProfileReport( )
+{
+	if( ProfileFrames == 0 )
+		return;
+
+	fprintf( stderr, "Profile: %d frames, %.3f cpu ms/frame\n", ProfileFrames, FrameCpuMs / ProfileFrames );
+	fprintf( stderr, "\t%-8s %9s %9s\n", "Pass", "cpu ms", "gpu ms" );
+	for( int p = 0; p < NUMPASSES; p++ )
+	{
+		if( PassGpuSamples[p] > 0 )
+			fprintf( stderr, "\t%-8s %9.3f %9.3f\n", PassNames[p],
+				PassCpuMs[p] / ProfileFrames, PassGpuMs[p] / PassGpuSamples[p] );
+		else
+			fprintf( stderr, "\t%-8s %9.3f %9s\n", PassNames[p], PassCpuMs[p] / ProfileFrames, "--" );
+	}
+	if( QueriesDropped > 0 )
+		fprintf( stderr, "\t(%d gpu timer results were not ready in time and were dropped)\n", QueriesDropped );
+}
+
+
+///// Hud functions
+
+// call a display list, counting it for the hud:
+
+void
+CallList( GLuint list )
+{
+	DrawCalls++;
+	if( list < ListVertices.size( ) )
+		VerticesSubmitted += ListVertices[list];
+	glCallList( list );
+}
+
+
+// remember how many vertices were emitted into a display list that was just compiled:
+
+void
+RecordListVertices( GLuint list )
+{
+	if( list >= ListVertices.size( ) )
+		ListVertices.resize( list + 1, 0 );
+	ListVertices[list] = ListVertexCount;
+	ListVertexCount = 0;
+}
+
+
+// render the hud font once with glutBitmapCharacter( ) into the back buffer,
+// read it back, and keep it as an alpha texture so the hud can be drawn
+// as one batch of textured quads instead of one bitmap call per character:
+// (the back buffer is cleared again by the caller)
+
+void
+InitGlyphAtlas( )
+{
+	GLsizei vx = glutGet( GLUT_WINDOW_WIDTH );
+	GLsizei vy = glutGet( GLUT_WINDOW_HEIGHT );
+	if( vx < ATLAS_SIZE  ||  vy < ATLAS_SIZE )
+		return;			// try again when the window is bigger
+
+	glViewport( 0, 0, vx, vy );
+	glMatrixMode( GL_PROJECTION );
+	glLoadIdentity( );
+	gluOrtho2D( 0., (GLdouble)vx, 0., (GLdouble)vy );
+	glMatrixMode( GL_MODELVIEW );
+	glLoadIdentity( );
+
+	glDisable( GL_DEPTH_TEST );
+	glDisable( GL_LIGHTING );
+	glDisable( GL_TEXTURE_2D );
+	glDisable( GL_FOG );
+	glClearColor( 0., 0., 0., 1. );
+	glClear( GL_COLOR_BUFFER_BIT );
+	glColor3f( 1., 1., 1. );
+
+	for( int c = GLYPH_FIRST; c <= GLYPH_LAST; c++ )
+	{
+		int cell = c - GLYPH_FIRST;
+		glRasterPos2i( ( cell % GLYPH_COLS ) * GLYPH_W, ( cell / GLYPH_COLS ) * GLYPH_H + 3 );
+		glutBitmapCharacter( GLUT_BITMAP_8_BY_13, c );
+	}
+
+	unsigned char *texels = new unsigned char[ ATLAS_SIZE * ATLAS_SIZE ];
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	glReadBuffer( GL_BACK );
+	glReadPixels( 0, 0, ATLAS_SIZE, ATLAS_SIZE, GL_RED, GL_UNSIGNED_BYTE, texels );
+
+	glGenTextures( 1, &GlyphAtlas );
+	glBindTexture( GL_TEXTURE_2D, GlyphAtlas );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA, ATLAS_SIZE, ATLAS_SIZE, 0, GL_ALPHA, GL_UNSIGNED_BYTE, texels );
+	TextureBytes += ATLAS_SIZE * ATLAS_SIZE;
+	delete [ ] texels;
+
+	glClearColor( BACKCOLOR[0], BACKCOLOR[1], BACKCOLOR[2], BACKCOLOR[3] );
+	glEnable( GL_DEPTH_TEST );
+}
+
+
+// add the quads for a string to the hud batch:
+// (x,y is the lower-left corner of the first character, in window pixels)
+
+void
+HudText( float x, float y, const char *s )
+{
+	const float ds = (float)GLYPH_W / (float)ATLAS_SIZE;
+	const float dt = (float)GLYPH_H / (float)ATLAS_SIZE;
+	for( ; *s != '\0'; s++, x += GLYPH_W )
+	{
+		int c = (unsigned char)*s;
+		if( c < GLYPH_FIRST  ||  c > GLYPH_LAST  ||  c == ' ' )
+			continue;
+		int cell = c - GLYPH_FIRST;
+		float s0 = ( cell % GLYPH_COLS ) * ds;
+		float t0 = ( cell / GLYPH_COLS ) * dt;
+		GLfloat quad[ ] =
+		{
+			x,           y,           s0,      t0,
+			x + GLYPH_W, y,           s0 + ds, t0,
+			x + GLYPH_W, y + GLYPH_H, s0 + ds, t0 + dt,
+			x,           y + GLYPH_H, s0,      t0 + dt,
+		};
+		HudVerts.insert( HudVerts.end( ), quad, quad + 16 );
+	}
+}
+
+
+// draw the frame statistics in the upper-left corner of the window:
+
+void
+DrawHud( )
+{
+	if( GlyphAtlas == 0 )
+		return;
+
+	// snapshot the scene's counters before the hud adds to them:
+
+	int drawCalls = DrawCalls;
+	int vertices = VerticesSubmitted;
+
+	// average the most recent frames for a steady fps readout:
+
+	const int AVGFRAMES = 30;
+	float sum = 0.;
+	int n = 0;
+	for( int i = 1; i <= AVGFRAMES; i++ )
+	{
+		float ft = FrameTimes[ ( FrameTimeIndex - i + HUD_GRAPH_FRAMES ) % HUD_GRAPH_FRAMES ];
+		if( ft > 0. )
+		{
+			sum += ft;
+			n++;
+		}
+	}
+	float avgMs = n > 0 ? sum / n : 0.f;
+
+	GLsizei vx = glutGet( GLUT_WINDOW_WIDTH );
+	GLsizei vy = glutGet( GLUT_WINDOW_HEIGHT );
+	glViewport( 0, 0, vx, vy );
+	glMatrixMode( GL_PROJECTION );
+	glLoadIdentity( );
+	gluOrtho2D( 0., (GLdouble)vx, 0., (GLdouble)vy );
+	glMatrixMode( GL_MODELVIEW );
+	glLoadIdentity( );
+
+	glDisable( GL_DEPTH_TEST );
+	glDisable( GL_LIGHTING );
+	glDisable( GL_FOG );
+
+	// the text:
+
+	char line[128];
+	float x = 10.;
+	float y = (float)vy - 10. - GLYPH_H;
+	HudVerts.clear( );
+
+	sprintf( line, "FPS: %6.1f  (%.2f ms)", avgMs > 0. ? 1000. / avgMs : 0., avgMs );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "Draw calls: %d", drawCalls );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "Vertices:   %d", vertices );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "Textures:   %.1f MB", (double)TextureBytes / ( 1024. * 1024. ) );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "Asteroids:  %d of %d  (%.2f ms)", AsteroidsDrawn, Belt.orbits.n, Belt.lastMs );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "Comets:     %d particles  (%.2f ms)", CometParticlesDrawn, Comets.lastMs );
+	HudText( x, y, line );			y -= GLYPH_H;
+	if( RingParticlesDrawn > 0 )
+		sprintf( line, "Rings:      %d of %d  (%.2f ms)", RingParticlesDrawn, Rings.orbits.n, Rings.lastMs );
+	else
+		sprintf( line, "Rings:      annulus" );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "GL state:   %d calls of %d asked for", Queue.cache.issued, Queue.cache.requested );
+	HudText( x, y, line );			y -= GLYPH_H;
+	if( Jobs.enabled )
+		sprintf( line, "Jobs:       %d threads, %d jobs, %d stolen", Jobs.threads, (int)Jobs.run, (int)Jobs.stolen );
+	else
+		sprintf( line, "Jobs:       GL thread only" );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "Depth:      %s", DepthModeName( Depth.mode ) );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "Culled:     %d bodies, %d of them hidden", Queue.culled, Queue.occluded );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "Lighting:   %s  (%dx%d spheres)", PerPixelNow ? "per-pixel" : "fixed function", SphereSlices, SphereSlices );
+	HudText( x, y, line );			y -= GLYPH_H;
+	sprintf( line, "Time warp:  %gx  (%s)", TimeWarp, PositionSource );
+	HudText( x, y, line );			y -= GLYPH_H;
+	if( TrueScaleOn != 0 )
+	{
+		sprintf( line, "True scale: %s%s, %.0f km up", TrueEye.flyStartMs >= 0. ? "flying to " : "",
+			TrueBodyName( TrueEye.focus ), TrueAltitudeKm );
+		HudText( x, y, line );			y -= GLYPH_H;
+	}
+	if( GravityOn != 0 )
+	{
+		sprintf( line, "Gravity:    %d bodies  %.2f ms/step  dE/E %.1e", Gravity.n, GravityStepMs, GravityDrift );
+		HudText( x, y, line );			y -= GLYPH_H;
+		sprintf( line, "Close:      %d pairs < %g  (%.2f ms)", (int)ClosePairs.size( ), CLOSE_APPROACH,
+			Approaches.sortMs + Approaches.queryMs );
+		HudText( x, y, line );			y -= GLYPH_H;
+	}
+	sprintf( line, "p99: %.2f ms  max: %.2f ms  stalls: %lld", HistPercentile( &FrameHist, 99. ),
+		FrameHist.maxMs, FrameHist.stalls );
+	HudText( x, y, line );			y -= GLYPH_H;
+
+	glEnable( GL_TEXTURE_2D );
+	glBindTexture( GL_TEXTURE_2D, GlyphAtlas );
+	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+	glEnable( GL_BLEND );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+	glColor3f( 1., 1., 1. );
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glVertexPointer( 2, GL_FLOAT, 4*sizeof(GLfloat), &HudVerts[0] );
+	glTexCoordPointer( 2, GL_FLOAT, 4*sizeof(GLfloat), &HudVerts[2] );
+	glDrawArrays( GL_QUADS, 0, (GLsizei)( HudVerts.size( ) / 4 ) );
+	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+	glDisableClientState( GL_VERTEX_ARRAY );
+
+	glDisable( GL_BLEND );
+	glDisable( GL_TEXTURE_2D );
+
+	// the frame-time graph, oldest frame on the left:
+
+	const float GW = 2. * HUD_GRAPH_FRAMES;
+	const float GH = 60.;
+	float gx = x;
+	float gy = y - GH - 4.;
+	float mspp = GH / HUD_GRAPH_MAXMS;		// pixels per ms
+
+	glColor3f( 0.3f, 0.3f, 0.3f );
+	glBegin( GL_LINE_LOOP );
+		glVertex2f( gx,      gy );
+		glVertex2f( gx + GW, gy );
+		glVertex2f( gx + GW, gy + GH );
+		glVertex2f( gx,      gy + GH );
+	glEnd( );
+
+	glColor3f( 0., 0.6f, 0. );				// the 60 fps line
+	glBegin( GL_LINES );
+		glVertex2f( gx,      gy + mspp * 1000.f/60.f );
+		glVertex2f( gx + GW, gy + mspp * 1000.f/60.f );
+	glEnd( );
+
+	glColor3f( 1., 1., 0. );
+	glBegin( GL_LINE_STRIP );
+		for( int i = 0; i < HUD_GRAPH_FRAMES; i++ )
+		{
+			float ft = FrameTimes[ ( FrameTimeIndex + i ) % HUD_GRAPH_FRAMES ];
+			if( ft > HUD_GRAPH_MAXMS )
+				ft = HUD_GRAPH_MAXMS;
+			glVertex2f( gx + 2.f*i, gy + mspp * ft );
+		}
+	glEnd( );
+
+	glEnable( GL_DEPTH_TEST );
+}
+
+
+///// Command line
+
+// parse the arguments that glutInit( ) did not consume:
+//	-benchmark [path|all]	replay a scripted camera path (default: overview), print the frame times and exit
+//	-warmup n				# of warm-up frames per path
+//	-frames n				# of measured frames per path
+//	-metrics [name]			export the frame-time metrics to name.csv and name.json on exit
+//	-coldstart				print the startup times and exit after the first presented frame
+
+bool
+ParseArgs( int argc, char *argv[ ] )
+{
+#ifdef BENCHMARK
+	BenchmarkOn = 1;
+#endif
+	BenchPath = BenchLastPath = 0;
+	BenchWarmup = BENCH_WARMUP_FRAMES;
+	BenchFrames = BENCH_FRAMES;
+	SwarmSize = 0;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( strcmp( argv[i], "-benchmark" ) == 0 )
+		{
+			BenchmarkOn = 1;
+			if( i+1 < argc  &&  argv[i+1][0] != '-' )
+			{
+				i++;
+				if( strcmp( argv[i], "all" ) == 0 )
+				{
+					BenchPath = 0;
+					BenchLastPath = NUMCAMERAPATHS - 1;
+					continue;
+				}
+
+				int p;
+				for( p = 0; p < NUMCAMERAPATHS; p++ )
+				{
+					if( strcmp( argv[i], CameraPaths[p].name ) == 0 )
+						break;
+				}
+				if( p == NUMCAMERAPATHS )
+				{
+					fprintf( stderr, "Unknown camera path '%s', the paths are:", argv[i] );
+					for( p = 0; p < NUMCAMERAPATHS; p++ )
+						fprintf( stderr, " %s", CameraPaths[p].name );
+					fprintf( stderr, " all\n" );
+					return false;
+				}
+				BenchPath = BenchLastPath = p;
+			}
+		}
+		else if( strcmp( argv[i], "-warmup" ) == 0  &&  i+1 < argc )
+		{
+			BenchWarmup = atoi( argv[++i] );
+			if( BenchWarmup < 0 )
+				BenchWarmup = 0;
+		}
+		else if( strcmp( argv[i], "-ephemeris" ) == 0  &&  i+1 < argc )
+		{
+			EphemerisFile = argv[++i];
+		}
+		else if( strcmp( argv[i], "-spk" ) == 0  &&  i+1 < argc )
+		{
+			SpkFileName = argv[++i];
+		}
+		else if( strcmp( argv[i], "-depth" ) == 0  &&  i+1 < argc )
+		{
+			i++;
+			if( strcmp( argv[i], "reversed" ) == 0 )
+				DepthModeAsked = DEPTH_REVERSED;
+			else if( strcmp( argv[i], "standard" ) == 0 )
+				DepthModeAsked = DEPTH_STANDARD;
+			else
+			{
+				fprintf( stderr, "Unknown depth mode '%s', the modes are: standard reversed\n", argv[i] );
+				return false;
+			}
+		}
+		else if( strcmp( argv[i], "-swarm" ) == 0  &&  i+1 < argc )
+		{
+			SwarmSize = atoi( argv[++i] );
+			if( SwarmSize < 0 )
+				SwarmSize = 0;
+		}
+		else if( strcmp( argv[i], "-coldstart" ) == 0 )
+		{
+			ColdStartOn = 1;
+		}
+		else if( strcmp( argv[i], "-metrics" ) == 0 )
+		{
+			MetricsOnExit = true;
+			if( i+1 < argc  &&  argv[i+1][0] != '-' )
+				MetricsName = argv[++i];
+		}
+		else if( strcmp( argv[i], "-frames" ) == 0  &&  i+1 < argc )
+		{
+			BenchFrames = atoi( argv[++i] );
+			if( BenchFrames < 2 )
+				BenchFrames = 2;
+		}
+		else
+		{
+			fprintf( stderr, "Don't know what to do with argument '%s'\n", argv[i] );
+			fprintf( stderr, "Usage: %s [-benchmark [path|all]] [-warmup n] [-frames n] [-metrics [name]] [-coldstart] [-swarm n] [-depth standard|reversed] [-ephemeris file] [-spk kernel]\n", argv[0] );
+			return false;
+		}
+	}
+	return true;
+}
+
+
+///// Benchmark functions
+//
+// the benchmark replaces Animate( ) with BenchmarkAnimate( ), which poses the
+// camera from the current path and steps the simulation clock by a fixed amount,
+// so that the frames rendered do not depend on the wall clock or the mouse.
+// every frame is finished with glFinish( ) so its time includes the gpu's work.
+
+void
+BenchmarkStartPath( int path )
+{
+	BenchPath = path;
+	BenchFrame = 0;
+	BenchLastMs = 0.;
+	BenchTimes.clear( );
+	BenchTimes.reserve( BenchFrames );
+	SimTime = 0.;
+	Reset( );
+	AxesOn = 0;
+}
+
+
+void
+BenchmarkAnimate( )
+{
+	const CameraPath *cp = &CameraPaths[BenchPath];
+
+	// where are we along the path?
+	// (the warm-up frames are rendered from the first key)
+
+	float t = 0.;
+	if( BenchFrame >= BenchWarmup )
+		t = (float)( BenchFrame - BenchWarmup ) / (float)( BenchFrames - 1 );
+
+	int k = 0;
+	while( k < cp->nkeys - 2  &&  t > cp->keys[k+1].t )
+		k++;
+	const CameraKey *k0 = &cp->keys[k];
+	const CameraKey *k1 = &cp->keys[ cp->nkeys > 1 ? k+1 : k ];
+	float f = 0.;
+	if( k1->t > k0->t )
+		f = ( t - k0->t ) / ( k1->t - k0->t );
+	if( f < 0. )	f = 0.;
+	if( f > 1. )	f = 1.;
+
+	Xrot     = k0->xrot     + f * ( k1->xrot     - k0->xrot );
+	Yrot     = k0->yrot     + f * ( k1->yrot     - k0->yrot );
+	Scale    = k0->scale    + f * ( k1->scale    - k0->scale );
+	TimeWarp = k0->timewarp + f * ( k1->timewarp - k0->timewarp );
+
+	SimTime += BENCH_DT_MS * TimeWarp;
+
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+void
+BenchmarkFrameDone( )
+{
+	glFinish( );
+	double now = NowMs( );
+	if( BenchFrame >= BenchWarmup  &&  BenchLastMs > 0. )
+		BenchTimes.push_back( now - BenchLastMs );
+	BenchLastMs = now;
+	BenchFrame++;
+
+	if( BenchFrame < BenchWarmup + BenchFrames )
+		return;
+
+	BenchmarkReport( );
+	if( BenchPath < BenchLastPath )
+	{
+		BenchmarkStartPath( BenchPath + 1 );
+		return;
+	}
+
+	glutSetWindow( MainWindow );
+	glutDestroyWindow( MainWindow );
+	exit( 0 );
+}
+
+
+// print the frame-time statistics of the path that just finished:
+// (percentiles use the nearest-rank method)
+
+void
+BenchmarkReport( )
+{
+	int n = (int)BenchTimes.size( );
+	if( n == 0 )
+		return;
+
+	std::vector<double> sorted( BenchTimes );
+	std::sort( sorted.begin( ), sorted.end( ) );
+
+	double sum = 0.;
+	for( int i = 0; i < n; i++ )
+		sum += sorted[i];
+	double mean = sum / n;
+
+	const int NUMPCT = 3;
+	const double pcts[NUMPCT] = { 50., 95., 99. };
+	double vals[NUMPCT];
+	for( int i = 0; i < NUMPCT; i++ )
+	{
+		int rank = (int)ceil( pcts[i] / 100. * n );
+		if( rank < 1 )	rank = 1;
+		vals[i] = sorted[rank-1];
+	}
+
+	printf( "benchmark %-8s  window %dx%d  warmup %d  frames %d\n", CameraPaths[BenchPath].name,
+		glutGet( GLUT_WINDOW_WIDTH ), glutGet( GLUT_WINDOW_HEIGHT ), BenchWarmup, n );
+	printf( "\tmean %8.3f ms  (%.1f fps)\n", mean, 1000. / mean );
+	printf( "\tmin  %8.3f ms\n", sorted[0] );
+	printf( "\tp50  %8.3f ms\n", vals[0] );
+	printf( "\tp95  %8.3f ms\n", vals[1] );
+	printf( "\tp99  %8.3f ms\n", vals[2] );
+	printf( "\tmax  %8.3f ms\n", sorted[n-1] );
+	fflush( stdout );
+}
+
+
+///// Frame-time metrics
+//
+// every frame's time goes into FrameHist, which costs one bucket increment and
+// keeps percentiles to better than 2% no matter how long the program runs.
+// 'e' exports the metrics on demand, -metrics exports them when the program exits.
+
+// which bucket holds a value of us microseconds:
+
+int
+HistBucket( long long us )
+{
+	const long long SUB = 1LL << HIST_SUBBITS;
+	if( us < 0 )
+		us = 0;
+	if( us >= ( 1LL << HIST_MAXBITS ) )
+		us = ( 1LL << HIST_MAXBITS ) - 1;
+	if( us < SUB )
+		return (int)us;
+
+	int msb = 0;
+	while( ( us >> ( msb + 1 ) ) != 0 )
+		msb++;
+	int e = msb - HIST_SUBBITS + 1;
+	return (int)( ( (long long)e << ( HIST_SUBBITS - 1 ) ) + ( us >> e ) );
+}
+
+
+// the range of values held by a bucket, in ms:
+
+double
+HistBucketLowMs( int b )
+{
+	const int HALF = 1 << ( HIST_SUBBITS - 1 );
+	if( b < 2*HALF )
+		return (double)b / 1000.;
+	int e = b / HALF - 1;
+	long long sub = b - (long long)e * HALF;
+	return (double)( sub << e ) / 1000.;
+}
+
+
+double
+HistBucketHighMs( int b )
+{
+	const int HALF = 1 << ( HIST_SUBBITS - 1 );
+	if( b < 2*HALF )
+		return (double)( b + 1 ) / 1000.;
+	int e = b / HALF - 1;
+	long long sub = b - (long long)e * HALF;
+	return (double)( ( sub + 1 ) << e ) / 1000.;
+}
+
+
+void
+HistRecord( FrameHistogram *h, double ms )
+{
+	h->counts[ HistBucket( (long long)( ms * 1000. + 0.5 ) ) ]++;
+	h->total++;
+	h->sumMs += ms;
+	if( ms > h->maxMs )
+		h->maxMs = ms;
+	if( ms > FRAMESTALL_MS )
+		h->stalls++;
+}
+
+
+// the frame time that pct percent of the frames are at or below:
+// (the middle of the bucket holding that rank, never more than the exact max)
+
+double
+HistPercentile( const FrameHistogram *h, double pct )
+{
+	if( h->total == 0 )
+		return 0.;
+
+	long long rank = (long long)ceil( pct / 100. * (double)h->total );
+	if( rank < 1 )
+		rank = 1;
+
+	long long seen = 0;
+	for( int b = 0; b < HIST_BUCKETS; b++ )
+	{
+		seen += h->counts[b];
+		if( seen >= rank )
+		{
+			double mid = ( HistBucketLowMs( b ) + HistBucketHighMs( b ) ) / 2.;
+			return mid < h->maxMs ? mid : h->maxMs;
+		}
+	}
+	return h->maxMs;
+}
+
+
+// write the summary and the non-empty buckets as name.csv and name.json:
+
+void
+ExportFrameTimes( )
+{
+	const FrameHistogram *h = &FrameHist;
+	double mean = h->total > 0 ? h->sumMs / (double)h->total : 0.;
+	double p50 = HistPercentile( h, 50. );
+	double p95 = HistPercentile( h, 95. );
+	double p99 = HistPercentile( h, 99. );
+
+	char filename[512];
+	sprintf( filename, "%.500s.csv", MetricsName );
+	FILE *fp = fopen( filename, "w" );
+	if( fp == NULL )
+	{
+		fprintf( stderr, "Cannot open metrics file '%s'\n", filename );
+		return;
+	}
+	fprintf( fp, "# frames,%lld\n# mean_ms,%.4f\n# p50_ms,%.4f\n# p95_ms,%.4f\n# p99_ms,%.4f\n# max_ms,%.4f\n",
+		h->total, mean, p50, p95, p99, h->maxMs );
+	fprintf( fp, "# stalls,%lld\n# stall_ms,%.1f\n", h->stalls, FRAMESTALL_MS );
+	fprintf( fp, "low_ms,high_ms,count\n" );
+	for( int b = 0; b < HIST_BUCKETS; b++ )
+	{
+		if( h->counts[b] != 0 )
+			fprintf( fp, "%.3f,%.3f,%lld\n", HistBucketLowMs( b ), HistBucketHighMs( b ), h->counts[b] );
+	}
+	fclose( fp );
+
+	sprintf( filename, "%.500s.json", MetricsName );
+	fp = fopen( filename, "w" );
+	if( fp == NULL )
+	{
+		fprintf( stderr, "Cannot open metrics file '%s'\n", filename );
+		return;
+	}
+	fprintf( fp, "{\n" );
+	fprintf( fp, "  \"frames\": %lld,\n", h->total );
+	fprintf( fp, "  \"mean_ms\": %.4f,\n", mean );
+	fprintf( fp, "  \"p50_ms\": %.4f,\n", p50 );
+	fprintf( fp, "  \"p95_ms\": %.4f,\n", p95 );
+	fprintf( fp, "  \"p99_ms\": %.4f,\n", p99 );
+	fprintf( fp, "  \"max_ms\": %.4f,\n", h->maxMs );
+	fprintf( fp, "  \"stalls\": %lld,\n", h->stalls );
+	fprintf( fp, "  \"stall_ms\": %.1f,\n", FRAMESTALL_MS );
+	fprintf( fp, "  \"buckets\": [" );
+	bool first = true;
+	for( int b = 0; b < HIST_BUCKETS; b++ )
+	{
+		if( h->counts[b] == 0 )
+			continue;
+		fprintf( fp, "%s\n    [ %.3f, %.3f, %lld ]", first ? "" : ",",
+			HistBucketLowMs( b ), HistBucketHighMs( b ), h->counts[b] );
+		first = false;
+	}
+	fprintf( fp, "\n  ]\n}\n" );
+	fclose( fp );
+
+	fprintf( stderr, "Frame times: %lld frames, p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms, %lld stalls -> %s.csv, %s.json\n",
+		h->total, p50, p95, p99, h->maxMs, h->stalls, MetricsName, MetricsName );
+}
+
+
+///// Startup timing
+//
+// main( ) and InitGraphics( ) mark the end of each stage, and Display( ) marks
+// the first frame once glFinish( ) returns, so the stages add up to the
+// time-to-first-frame. (the time before main( ) runs is not included.)
+
+void
+StartupMark( int stage )
+{
+	double now = NowMs( );
+	StartupMs[stage] = now - StartupLastMs;
+	StartupLastMs = now;
+}
+
+
+// the cold-start run prints to stdout so the numbers can be collected by a script:
+
+void
+StartupReport( )
+{
+	FILE *fp = ColdStartOn != 0 ? stdout : stderr;
+	double total = 0.;
+	fprintf( fp, "Startup:\n" );
+	for( int i = 0; i < NUMSTARTUPSTAGES; i++ )
+	{
+		fprintf( fp, "\t%-12s %9.2f ms\n", StartupStageNames[i], StartupMs[i] );
+		total += StartupMs[i];
+	}
+	fprintf( fp, "\t%-12s %9.2f ms\n", "to 1st frame", total );
+	fflush( fp );
+}
+
+
+///// Asteroid belt functions
+
+void
+InitAsteroids( )
+{
+	AsteroidsInit( &Belt, NUMASTEROIDS, ASTEROID_AMIN, ASTEROID_AMAX, orbital_period_scale_factor( 1. ), 12345 );
+	Belt.budgetMs = ASTEROID_BUDGET_MS;
+	Belt.jobs = &Jobs;
+
+	// the positions are streamed into a vertex buffer that is mapped each frame:
+
+	if( GLEW_VERSION_3_0  ||  GLEW_ARB_map_buffer_range )
+	{
+		glGenBuffers( 1, &AsteroidBuffer );
+		glBindBuffer( GL_ARRAY_BUFFER, AsteroidBuffer );
+		glBufferData( GL_ARRAY_BUFFER, 3 * sizeof(float) * NUMASTEROIDS, NULL, GL_STREAM_DRAW );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	}
+
+	// Saturn's ring particles work the same way, in Saturn's frame:
+
+	AsteroidsInitRings( &Rings, NUMRINGPARTICLES, RingBands, NUMRINGBANDS, RING_PERIOD_SCALE, 54321 );
+	Rings.budgetMs = RING_BUDGET_MS;
+	Rings.jobs = &Jobs;
+	if( AsteroidBuffer != 0 )
+	{
+		glGenBuffers( 1, &RingBuffer );
+		glBindBuffer( GL_ARRAY_BUFFER, RingBuffer );
+		glBufferData( GL_ARRAY_BUFFER, 3 * sizeof(float) * NUMRINGPARTICLES, NULL, GL_STREAM_DRAW );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	}
+
+	// a soft round dot for the point sprites:
+
+	unsigned char texels[SPRITE_SIZE * SPRITE_SIZE];
+	for( int t = 0; t < SPRITE_SIZE; t++ )
+	{
+		for( int s = 0; s < SPRITE_SIZE; s++ )
+		{
+			float ds = ( (float)s + 0.5f ) / ( SPRITE_SIZE / 2 ) - 1.f;
+			float dt = ( (float)t + 0.5f ) / ( SPRITE_SIZE / 2 ) - 1.f;
+			float a = 1.f - sqrtf( ds*ds + dt*dt );
+			texels[ t*SPRITE_SIZE + s ] = a <= 0. ? 0 : (unsigned char)( 255.f * ( a < 0.5f ? 2.f*a : 1.f ) );
+		}
+	}
+	glGenTextures( 1, &SpriteTex );
+	glBindTexture( GL_TEXTURE_2D, SpriteTex );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA, SPRITE_SIZE, SPRITE_SIZE, 0, GL_ALPHA, GL_UNSIGNED_BYTE, texels );
+	TextureBytes += SPRITE_SIZE * SPRITE_SIZE;
+}
+
+
+// propagate the belt straight into the vertex buffer and draw it as point sprites:
+
+void
+DrawAsteroids( )
+{
+	AsteroidsDrawn = DrawParticles( &Belt, AsteroidBuffer, &AsteroidXyz, NUMASTEROIDS, ASTEROID_POINT_SIZE,
+						0.55f, 0.50f, 0.45f );
+}
+
+
+// propagate a belt straight into its vertex buffer and draw it as point sprites:
+// (capacity is the buffer's size in particles; returns the # drawn)
+
+int
+DrawParticles( AsteroidBelt *ab, GLuint buffer, std::vector<float> *fallback, int capacity, float size,
+		float r, float g, float b )
+{
+	int n = ab->active;		// AsteroidsUpdate( ) sets the count for the next frame
+	float *xyz = NULL;
+
+	if( buffer != 0 )
+	{
+		// orphan last frame's storage so mapping never waits for the gpu:
+		glBindBuffer( GL_ARRAY_BUFFER, buffer );
+		glBufferData( GL_ARRAY_BUFFER, 3 * sizeof(float) * capacity, NULL, GL_STREAM_DRAW );
+		xyz = (float *)glMapBufferRange( GL_ARRAY_BUFFER, 0, 3 * sizeof(float) * n,
+						GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+	}
+
+	if( xyz != NULL )
+	{
+		AsteroidsUpdate( ab, SimTime, xyz );
+		glUnmapBuffer( GL_ARRAY_BUFFER );
+		glVertexPointer( 3, GL_FLOAT, 0, (const GLvoid *)0 );
+	}
+	else
+	{
+		fallback->resize( 3 * capacity );
+		AsteroidsUpdate( ab, SimTime, &(*fallback)[0] );
+		if( buffer != 0 )
+		{
+			glBufferSubData( GL_ARRAY_BUFFER, 0, 3 * sizeof(float) * n, &(*fallback)[0] );
+			glVertexPointer( 3, GL_FLOAT, 0, (const GLvoid *)0 );
+		}
+		else
+			glVertexPointer( 3, GL_FLOAT, 0, &(*fallback)[0] );
+	}
+
+	glDisable( GL_LIGHTING );
+	glEnable( GL_TEXTURE_2D );
+	glBindTexture( GL_TEXTURE_2D, SpriteTex );
+	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+	if( GLEW_VERSION_2_0 )
+	{
+		glEnable( GL_POINT_SPRITE );
+		glTexEnvi( GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE );
+	}
+	glEnable( GL_BLEND );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+	glDepthMask( GL_FALSE );
+	glPointSize( size );
+	glColor3f( r, g, b );
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glDrawArrays( GL_POINTS, 0, n );
+	glDisableClientState( GL_VERTEX_ARRAY );
+	DrawCalls++;
+	VerticesSubmitted += n;
+
+	if( buffer != 0 )
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glPointSize( 1. );
+	glDepthMask( GL_TRUE );
+	glDisable( GL_BLEND );
+	if( GLEW_VERSION_2_0 )
+	{
+		glTexEnvi( GL_POINT_SPRITE, GL_COORD_REPLACE, GL_FALSE );
+		glDisable( GL_POINT_SPRITE );
+	}
+	glDisable( GL_TEXTURE_2D );
+	glEnable( GL_LIGHTING );
+	return n;
+}
+
+
+// how many pixels the radius of a sphere of radius r around the origin of
+// modelview covers on the screen, for picking a level of detail:
+// (read off this frame's Projection, so it follows the projection in use,
+//  and touches no GL, so any thread can call it)
+
+float
+PixelRadius( const Mat4 *modelView, float r )
+{
+	const float *mv = modelView->m;
+	float eyeR = r * sqrtf( mv[0]*mv[0] + mv[1]*mv[1] + mv[2]*mv[2] );
+	float pixels = eyeR * Projection.m[5] * (float)ViewportSize / 2.f;
+	if( Projection.m[11] == 0. )
+		return pixels;								// orthographic: no foreshortening
+
+	float depth = -mv[14];
+	if( depth <= eyeR )
+		return (float)ViewportSize;					// the eye is inside it
+	return pixels / depth;
+}
+
+
+///// Per-pixel lighting functions
+
+// build the lighting program and give it every body's material -- the
+// same Material values fixed function gets:
+
+void
+InitShading( )
+{
+	if( ! ShadingInit( &Shader, NUMSHADEDBODIES ) )
+		return;
+	ShadingSetBody( &Shader, BODY_SUN, &WhiteMaterial, true, true );
+	for( int p = 0; p < NUMPLANETS; p++ )
+		ShadingSetBody( &Shader, BODY_PLANETS + p, &WhiteMaterial, false, true );
+	ShadingSetBody( &Shader, BODY_RINGS, &WhiteMaterial, false, true );
+	for( int m = 0; m < NUMMOONS; m++ )
+		ShadingSetBody( &Shader, BODY_MOONS + m, &MoonMaterial[m], false, false );
+}
+
+
+// set up the depth buffer asked for at startup:
+// (reversed-Z falls back to the standard one without GL 4.5's clip control)
+
+void
+InitDepth( )
+{
+	DepthInit( &Depth, DepthModeAsked );
+	fprintf( stderr, "Depth buffer: %s\n", DepthModeName( Depth.mode ) );
+}
+
+
+///// Render queue functions
+
+void
+InitRenderQueue( )
+{
+	RenderInit( &Queue );
+	RenderTranslucent( &Queue, PASS_RINGS );
+	WhiteMaterialId = RenderAddMaterial( &Queue, &WhiteMaterial );
+
+	// the moons have no textures, so each gets a plain colored material:
+	for( int m = 0; m < NUMMOONS; m++ )
+		MoonMaterialIds[m] = RenderAddMaterial( &Queue, &MoonMaterial[m] );
+}
+
+
+// put a list in a thread's buffer, unless the sphere of radius around the
+// model's origin is wholly out of view, or wholly behind the Sun or a planet:
+
+void
+QueueList( RenderBuffer *rb, int layer, GLuint list, GLuint texture, bool lit, int material, int body,
+		const Mat4 *model, float radius )
+{
+	if( ! SphereInFrustum( FrustumPlanes, &model->m[12], radius ) )
+	{
+		rb->culled++;
+		return;
+	}
+	if( SphereHidden( &model->m[12], radius ) )
+	{
+		rb->culled++;
+		rb->occluded++;
+		return;
+	}
+	int vertices = list < ListVertices.size( ) ? ListVertices[list] : 0;
+	RenderSubmit( rb, layer, list, vertices, texture, lit, material, body, model );
+}
+
+
+// take the Sun and the planets -- the bodies big enough to hide others --
+// to eye coordinates, for SphereHidden( ), before the jobs that use them:
+// (what is drawn is OsuSphere( )'s polyhedron, whose vertices are on the
+//  sphere and whose faces dip inside it, so each occluder is the sphere
+//  inscribed in the polyhedron, cos(dlng/2) cos(dlat/2) of the radius --
+//  otherwise something just behind a limb could be culled while it still
+//  shows past the facets)
+
+void
+GatherOccluders( )
+{
+	NumOccluders = 0;
+	if( OcclusionOn == 0 )
+		return;
+
+	float dlng = (float)( 2. * M_PI / ( SphereSlices - 1 ) );
+	float dlat = (float)( M_PI / ( SphereSlices - 1 ) );
+	float inscribed = cosf( dlng / 2.f ) * cosf( dlat / 2.f );
+
+	for( int body = BODY_SUN; body < BODY_RINGS; body++ )
+	{
+		float c[3], radius;
+		ShadedBodySphere( body, c, &radius );
+		Mat4TransformPoint( &View, c, Occluders[NumOccluders] );
+		Occluders[NumOccluders][3] = inscribed * radius * ViewScale;
+		NumOccluders++;
+	}
+}
+
+
+// where body is in the scene this frame and how big, in true scale or not:
+// (the rings' sphere is the one around their outer edge)
+
+void
+ShadedBodySphere( int body, float c[3], float *radius )
+{
+	bool trueScale = TrueScaleOn != 0;
+	int node;
+	if( body == BODY_SUN )
+	{
+		node = SunNode;
+		*radius = trueScale ? (float)TrueRadiusKm[0] : SUN_RADIUS;
+	}
+	else if( body < BODY_RINGS )
+	{
+		int p = body - BODY_PLANETS;
+		node = PlanetNodes[p];
+		*radius = trueScale ? (float)TrueRadiusKm[1+p] : PlanetLooks[p].radius;
+	}
+	else if( body == BODY_RINGS )
+	{
+		node = PlanetNodes[SATURN];
+		*radius = trueScale ? (float)TRUE_RINGS_OUTER_KM : RingBands[NUMRINGBANDS-1].amax;
+	}
+	else
+	{
+		int m = body - BODY_MOONS;
+		node = MoonNodes[m];
+		*radius = trueScale ? (float)TrueRadiusKm[1+NUMPLANETS+m] : Moons[m].radius;
+	}
+	for( int k = 0; k < 3; k++ )
+		c[k] = DrawScene->world[node].m[12+k];
+}
+
+
+// the broad phase of the shadows: for each planet, moon and the rings, the
+// planets and moons that may be between it and the Sun, for the lighting
+// program to shade it with, and the rings' plane for Saturn:
+// (returns the Sun's radius in eye coordinates through sunRadius)
+
+void
+GatherShadows( float *sunRadius )
+{
+	float sun[3], sunR;
+	ShadedBodySphere( BODY_SUN, sun, &sunR );
+	*sunRadius = sunR * ViewScale;
+
+	float centers[NUMSHADEDBODIES][3], radii[NUMSHADEDBODIES];
+	for( int body = 0; body < NUMSHADEDBODIES; body++ )
+		ShadedBodySphere( body, centers[body], &radii[body] );
+
+	for( int body = BODY_PLANETS; body < NUMSHADEDBODIES; body++ )
+	{
+		float occluders[SHADOW_MAX_OCCLUDERS][4];
+		int n = 0;
+		for( int o = BODY_PLANETS; o < NUMSHADEDBODIES  &&  ShadowsOn != 0; o++ )
+		{
+			if( o == body  ||  o == BODY_RINGS  ||  n == SHADOW_MAX_OCCLUDERS )
+				continue;
+			if( ! SphereInShadow( centers[body], radii[body], centers[o], radii[o], sun, sunR ) )
+				continue;
+			Mat4TransformPoint( &View, centers[o], occluders[n] );
+			occluders[n][3] = radii[o] * ViewScale;
+			n++;
+		}
+		ShadingSetShadows( &Shader, body, occluders, n );
+	}
+
+	// the annulus lies in Saturn's xz plane, across the ring bands, before
+	// true scale blows it up:
+
+	const float *saturn = DrawScene->world[PlanetNodes[SATURN]].m;
+	float s = TrueScaleOn != 0 ? (float)( TRUE_RINGS_OUTER_KM / RingBands[NUMRINGBANDS-1].amax ) : 1.f;
+	float center[3], normal[3];
+	Mat4TransformPoint( &View, &saturn[12], center );
+	for( int k = 0; k < 3; k++ )
+		normal[k] = View.m[k] * saturn[4] + View.m[4+k] * saturn[5] + View.m[8+k] * saturn[6];
+	Vec3Unit( normal, normal );
+	ShadingSetRingShadow( &Shader, BODY_PLANETS + SATURN, center, normal,
+			RingBands[0].amin * s * ViewScale, RingBands[NUMRINGBANDS-1].amax * s * ViewScale,
+			ShadowsOn != 0 ? RING_SHADOW_OPACITY : 0.f );
+}
+
+
+// true if the sphere of radius r around c, in the scene, is wholly hidden
+// by one of the occluders:
+// (a body never hides itself, so the occluders need not leave it out)
+
+bool
+SphereHidden( const float c[3], float r )
+{
+	if( NumOccluders == 0 )
+		return false;
+	float eye[3];
+	Mat4TransformPoint( &View, c, eye );
+	for( int o = 0; o < NumOccluders; o++ )
+		if( SphereOccluded( eye, r * ViewScale, Occluders[o], Occluders[o][3], ViewOrtho ) )
+			return true;
+	return false;
+}
+
+
+// put the Sun, the planets, the moons and -- unless it is close enough to
+// be drawn as particles -- the ring annulus in the render queue, each in
+// its profiler pass's layer, as jobs writing into their threads' buffers:
+
+void
+QueueBodies( double ms )
+{
+	JobsRun( &Jobs, BuildPackets, &ms, NUMPACKETS, PACKET_JOB_SIZE );
+}
+
+
+void
+BuildPackets( void *arg, int first, int count, int thread )
+{
+	double ms = *(double *)arg;
+	for( int i = first; i < first + count; i++ )
+		BuildPacket( &Queue.buffers[thread], i, ms );
+}
+
+
+// packet i: the Sun, then the planets, then the moons, then the rings:
+// (only reads the scene, so the packets can be built in any order; the
+//  spins are taken modulo their periods in double, as SimTime runs past
+//  any int within minutes at high warp)
+
+void
+BuildPacket( RenderBuffer *rb, int i, double ms )
+{
+	static const GLuint *planetLists[NUMPLANETS] = { &Mercury, &Venus, &Earth, &Mars, &Jupiter, &Saturn, &Uranus, &Neptune, &Pluto };
+	const SceneGraph *sg = DrawScene;
+	bool trueScale = TrueScaleOn != 0;
+	Mat4 turn, spin, tmp, size, model;
+
+	// (in true scale each list is blown up from its scene radius to the real one, in km)
+
+	if( i == 0 )
+	{
+		float s = trueScale ? (float)( TrueRadiusKm[0] / SUN_RADIUS ) : 1.f;
+		Mat4RotateY( &spin, 360.f * (float)( fmod( ms, (double)SUN_ROTATION_PERIOD ) / SUN_ROTATION_PERIOD ) );
+		Mat4Scale( &size, s );
+		Mat4Multiply( &sg->world[SunNode], &spin, &tmp );
+		Mat4Multiply( &tmp, &size, &model );
+		QueueList( rb, PASS_SUN, Sun, Tex[0], false, WhiteMaterialId, BODY_SUN, &model, SUN_RADIUS * s );
+		return;
+	}
+	i -= 1;
+
+	if( i < NUMPLANETS )
+	{
+		int p = i;
+		const PlanetLook *pl = &PlanetLooks[p];
+		float s = trueScale ? (float)( TrueRadiusKm[1+p] / pl->radius ) : 1.f;
+		int period = pl->period < 0 ? -pl->period : pl->period;
+		float angle = 360.f * (float)( fmod( ms, (double)period ) / period );
+		Mat4RotateY( &turn, pl->turn );
+		Mat4RotateY( &spin, pl->period < 0 ? -angle : angle );
+		Mat4Scale( &size, s );
+		Mat4Multiply( &sg->world[PlanetNodes[p]], &turn, &model );
+		Mat4Multiply( &model, &spin, &tmp );
+		Mat4Multiply( &tmp, &size, &model );
+		QueueList( rb, PASS_PLANETS, *planetLists[p], Tex[pl->texture], true, WhiteMaterialId, BODY_PLANETS + p,
+				&model, pl->radius * s );
+		return;
+	}
+	i -= NUMPLANETS;
+
+	if( i < NUMMOONS )
+	{
+		int m = i;
+		float r = trueScale ? (float)TrueRadiusKm[1+NUMPLANETS+m] : Moons[m].radius;
+		Mat4Scale( &size, r );
+		Mat4Multiply( &sg->world[MoonNodes[m]], &size, &model );
+		QueueList( rb, PASS_MOONS, MoonSphere, 0, true, MoonMaterialIds[m], BODY_MOONS + m, &model, r );
+		return;
+	}
+
+	// the rings, whose level of detail -- particles or the annulus -- is
+	// picked by how big they are on the screen:
+
+	// (true scale has no particles, and fits the annulus's outer edge to the A ring's)
+
+	float outer = RingBands[NUMRINGBANDS-1].amax;
+	float s = trueScale ? (float)( TRUE_RINGS_OUTER_KM / outer ) : 1.f;
+	Mat4RotateY( &turn, 27. );
+	Mat4Multiply( &sg->world[PlanetNodes[SATURN]], &turn, &RingFrame );
+	Mat4 ringView;
+	Mat4Multiply( &View, &RingFrame, &ringView );
+	RingParticlesNow = RingParticlesOn != 0  &&  ! trueScale  &&  PixelRadius( &ringView, outer ) > RING_PARTICLE_PIXELS;
+	if( ! RingParticlesNow )
+	{
+		Mat4Scale( &size, s );
+		Mat4Multiply( &RingFrame, &size, &model );
+		QueueList( rb, PASS_RINGS, SaturnRings, Tex[RINGS_TEXTURE], true, WhiteMaterialId, BODY_RINGS, &model, outer * s );
+	}
+}
+
+
+///// True scale functions
+
+// where the true-scale eye is and what it sees: the bodies at their real
+// positions, rebased on the eye, the view and a projection fitted to them:
+// (q is the scene's rotation, which turns the eye about the body it looks at)
+
+void
+TrueScaleView( const Quat *q )
+{
+	TrueScalePositions( &Model, SimTime, TruePos );
+
+	// the eye is off the body in the default view's direction, turned the
+	// other way from the scene, and zoomed with Scale:
+
+	Quat turn = { -q->x, -q->y, -q->z, q->w };
+	float back[3] = { 0., 10., -120. };
+	float up[3]   = { 0., 1., 0. };
+	float dir[3];
+	Vec3Unit( back, back );
+	QuatRotate( &turn, back, dir );
+	QuatRotate( &turn, up, up );
+	double radius = TrueRadiusKm[TrueEye.focus];
+	double height = radius * TRUE_VIEW_RADII * exp( -TRUE_ZOOM_RATE * ( Scale - 1. ) );
+	TrueCameraUpdate( &TrueEye, TruePos, dir, radius + height, NowMs( ) );
+
+	// the floating origin:
+
+	float rel[3*NUMTRUEBODIES];
+	TrueScaleRebase( TruePos, NUMTRUEBODIES, TrueEye.eye, rel );
+	SceneSetTranslation( &Rebased, SunNode, rel[0], rel[1], rel[2] );
+	for( int p = 0; p < NUMPLANETS; p++ )
+		SceneSetTranslation( &Rebased, PlanetNodes[p], rel[3*(1+p)+0], rel[3*(1+p)+1], rel[3*(1+p)+2] );
+	for( int m = 0; m < NUMMOONS; m++ )
+	{
+		int b = 1 + NUMPLANETS + m;
+		SceneSetTranslation( &Rebased, MoonNodes[m], rel[3*b+0], rel[3*b+1], rel[3*b+2] );
+	}
+	SceneUpdate( &Rebased );
+
+	// the clip planes: the near one halfway to the closest surface, the far
+	// one past the farthest body:
+
+	double nearest = 1.e30, farthest = 0.;
+	for( int b = 0; b < NUMTRUEBODIES; b++ )
+	{
+		double d = sqrt( (double)Vec3Dot( &rel[3*b], &rel[3*b] ) );
+		nearest = std::min( nearest, d - TrueRadiusKm[b] );
+		farthest = std::max( farthest, d + TrueRadiusKm[b] );
+		if( b == TrueEye.focus )
+			TrueAltitudeKm = (float)( d - TrueRadiusKm[b] );
+	}
+	double znear = std::max( 0.5 * nearest, TRUE_MIN_NEAR_KM );
+	double zfar = 1.01 * farthest;
+	DepthPerspective( &Depth, &Projection, 60., 1., (float)znear, (float)zfar );
+	TrueSkyScale = (float)( 0.9 * zfar / ( 150. * sqrt( 3. ) ) );		// DeepSpace( )'s corners
+
+	float eye[3] = { 0., 0., 0. };
+	Mat4LookAt( &View, eye, &rel[ 3*TrueEye.focus ], up );
+}
+
+
+const char *
+TrueBodyName( int b )
+{
+	if( b == 0 )
+		return "Sun";
+	if( b <= NUMPLANETS )
+		return PlanetNames[b-1];
+	return Moons[ b - 1 - NUMPLANETS ].name;
+}
+
+
+///// Job system functions
+
+// start a worker for every core but the GL thread's, and stop them at exit,
+// before the JobSystem's threads are destroyed with them still running:
+
+void
+InitJobs( )
+{
+	JobsInit( &Jobs, 0 );
+	atexit( ShutdownJobs );
+}
+
+
+void
+ShutdownJobs( )
+{
+	JobsShutdown( &Jobs );
+}
+
+
+///// Comet functions
+
+void
+InitComets( )
+{
+	CometsInit( &Comets, NUMCOMETS, COMET_CAPACITY, orbital_period_scale_factor( 1. ), 2024 );
+	Comets.jobs = &Jobs;
+	if( GLEW_VERSION_3_0  ||  GLEW_ARB_map_buffer_range )
+	{
+		glGenBuffers( 1, &CometBuffer );
+		glBindBuffer( GL_ARRAY_BUFFER, CometBuffer );
+		glBufferData( GL_ARRAY_BUFFER, sizeof(CometVertex) * NUMCOMETS * COMET_CAPACITY, NULL, GL_STREAM_DRAW );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	}
+}
+
+
+// shed and move the tails straight into the vertex buffer, draw each comet's
+// live particles as glowing point sprites in one call, then the nuclei:
+
+void
+DrawComets( )
+{
+	CometVertex *verts = NULL;
+	if( CometBuffer != 0 )
+	{
+		// orphan last frame's storage so mapping never waits for the gpu:
+		glBindBuffer( GL_ARRAY_BUFFER, CometBuffer );
+		glBufferData( GL_ARRAY_BUFFER, sizeof(CometVertex) * NUMCOMETS * COMET_CAPACITY, NULL, GL_STREAM_DRAW );
+		verts = (CometVertex *)glMapBufferRange( GL_ARRAY_BUFFER, 0, sizeof(CometVertex) * NUMCOMETS * COMET_CAPACITY,
+						GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+	}
+
+	const GLvoid *base;
+	if( verts != NULL )
+	{
+		CometParticlesDrawn = CometsUpdate( &Comets, SimTime, Lighting.sun.position, verts );
+		glUnmapBuffer( GL_ARRAY_BUFFER );
+		base = (const GLvoid *)0;
+	}
+	else
+	{
+		CometVerts.resize( NUMCOMETS * COMET_CAPACITY );
+		CometParticlesDrawn = CometsUpdate( &Comets, SimTime, Lighting.sun.position, &CometVerts[0] );
+		if( CometBuffer != 0 )
+		{
+			glBufferSubData( GL_ARRAY_BUFFER, 0, sizeof(CometVertex) * CometVerts.size( ), &CometVerts[0] );
+			base = (const GLvoid *)0;
+		}
+		else
+			base = &CometVerts[0];
+	}
+
+	glDisable( GL_LIGHTING );
+	glEnable( GL_TEXTURE_2D );
+	glBindTexture( GL_TEXTURE_2D, SpriteTex );
+	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+	if( GLEW_VERSION_2_0 )
+	{
+		glEnable( GL_POINT_SPRITE );
+		glTexEnvi( GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE );
+	}
+	glEnable( GL_BLEND );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE );			// the tails glow, so they add up
+	glDepthMask( GL_FALSE );
+	glPointSize( COMET_POINT_SIZE );
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_COLOR_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, sizeof(CometVertex), base );
+	glColorPointer( 4, GL_UNSIGNED_BYTE, sizeof(CometVertex), (const GLubyte *)base + offsetof( CometVertex, rgba ) );
+	glMultiDrawArrays( GL_POINTS, &Comets.first[0], &Comets.count[0], NUMCOMETS );
+	glDisableClientState( GL_COLOR_ARRAY );
+	DrawCalls++;
+	VerticesSubmitted += CometParticlesDrawn;
+	if( CometBuffer != 0 )
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	// the nuclei, on top of their comae:
+	glPointSize( NUCLEUS_SIZE );
+	glColor3f( 1., 1., 0.95f );
+	glVertexPointer( 3, GL_FLOAT, 0, &Comets.nucleus[0] );
+	glDrawArrays( GL_POINTS, 0, NUMCOMETS );
+	glDisableClientState( GL_VERTEX_ARRAY );
+	DrawCalls++;
+	VerticesSubmitted += NUMCOMETS;
+
+	glPointSize( 1. );
+	glDepthMask( GL_TRUE );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+	glDisable( GL_BLEND );
+	if( GLEW_VERSION_2_0 )
+	{
+		glTexEnvi( GL_POINT_SPRITE, GL_COORD_REPLACE, GL_FALSE );
+		glDisable( GL_POINT_SPRITE );
+	}
+	glDisable( GL_TEXTURE_2D );
+	glEnable( GL_LIGHTING );
+}
+
+
+///// Gravity functions
+//
+// gravity mode starts the Sun, the planets and the optional test swarm from
+// where their Kepler orbits have them now, then lets them pull on each other.
+// the orbit paths still show the Kepler ellipses, so the planets can be seen
+// drifting off them over many orbits.
+
+void
+InitGravity( )
+{
+	NBodyInit( &Gravity, NBODY_G, NBODY_SOFTENING, NBODY_THETA );
+	NBodyAdd( &Gravity, 1., 0., 0., 0., 0., 0., 0. );
+
+	// velocities by central differences of the Kepler positions, 1 ms either side:
+
+	float before[NUMPLANETS][3], after[NUMPLANETS][3];
+	KeplerPropagate( &Model.planets, SimTime - 1., 0, NUMPLANETS, &before[0][0] );
+	KeplerPropagate( &Model.planets, SimTime, 0, NUMPLANETS, &PlanetPos[0][0] );
+	KeplerPropagate( &Model.planets, SimTime + 1., 0, NUMPLANETS, &after[0][0] );
+	for( int p = 0; p < NUMPLANETS; p++ )
+	{
+		NBodyAdd( &Gravity, PlanetMasses[p], PlanetPos[p][0], PlanetPos[p][1], PlanetPos[p][2],
+			( after[p][0] - before[p][0] ) / 2., ( after[p][1] - before[p][1] ) / 2., ( after[p][2] - before[p][2] ) / 2. );
+	}
+
+	// the swarm, on nearly circular orbits near the ecliptic:
+	// (xorshift, as the rest of the simulation seeds itself, so every run gets the same swarm)
+
+	unsigned int state = 12345;
+	double u[3];
+	for( int i = 0; i < SwarmSize; i++ )
+	{
+		for( int k = 0; k < 3; k++ )
+		{
+			state ^= state << 13;	state ^= state >> 17;	state ^= state << 5;
+			u[k] = (double)( state >> 8 ) / (double)( 1 << 24 );
+		}
+		double a = SWARM_AMIN + ( SWARM_AMAX - SWARM_AMIN ) * u[0];
+		double ang = 2. * M_PI * u[1];
+		double h = 0.02 * a * ( u[2] - 0.5 );
+		double v = sqrt( NBODY_G / a );
+		NBodyAdd( &Gravity, SWARM_MASS, a * cos( ang ), h, a * sin( ang ), -v * sin( ang ), 0., v * cos( ang ) );
+	}
+
+	// move to the barycenter's frame so the whole system does not wander off:
+
+	double mass = 0., px = 0., py = 0., pz = 0.;
+	for( int i = 0; i < Gravity.n; i++ )
+	{
+		mass += Gravity.m[i];
+		px += Gravity.m[i] * Gravity.vx[i];
+		py += Gravity.m[i] * Gravity.vy[i];
+		pz += Gravity.m[i] * Gravity.vz[i];
+	}
+	for( int i = 0; i < Gravity.n; i++ )
+	{
+		Gravity.vx[i] -= px / mass;
+		Gravity.vy[i] -= py / mass;
+		Gravity.vz[i] -= pz / mass;
+	}
+
+	NBodyComputeForces( &Gravity );
+	SpatialInit( &Approaches, CLOSE_APPROACH );
+	ClosePairs.clear( );
+	GravityTime = SimTime;
+	GravityE0 = NBodyEnergy( &Gravity );
+	GravityDrift = 0.;
+	GravityStepMs = 0.;
+	GravityFrames = 0;
+}
+
+
+// integrate up to the current simulation time and pull out the planets' positions:
+// (at high time warps the steps are stretched rather than run more than
+//  NBODY_MAX_STEPS a frame, which shows up in the energy drift)
+
+void
+StepGravity( )
+{
+	double span = SimTime - GravityTime;
+	if( span > 0. )
+	{
+		int steps = (int)ceil( span / NBODY_STEP_MS );
+		if( steps > NBODY_MAX_STEPS )
+			steps = NBODY_MAX_STEPS;
+		double dt = span / steps;
+		double start = NowMs( );
+		for( int s = 0; s < steps; s++ )
+			NBodyStep( &Gravity, dt );
+		GravityStepMs = ( NowMs( ) - start ) / steps;
+		GravityTime = SimTime;
+	}
+
+	if( ++GravityFrames % NBODY_ENERGY_EVERY == 0 )
+		GravityDrift = ( NBodyEnergy( &Gravity ) - GravityE0 ) / fabs( GravityE0 );
+
+	// everything is drawn relative to the Sun, which sits at the origin:
+
+	int n = Gravity.n;
+	GravityXyz.resize( 3 * n );
+	for( int i = 0; i < n; i++ )
+	{
+		GravityXyz[3*i+0] = (float)( Gravity.x[i] - Gravity.x[0] );
+		GravityXyz[3*i+1] = (float)( Gravity.y[i] - Gravity.y[0] );
+		GravityXyz[3*i+2] = (float)( Gravity.z[i] - Gravity.z[0] );
+	}
+	for( int p = 0; p < NUMPLANETS; p++ )
+	{
+		PlanetPos[p][0] = GravityXyz[3*(p+1)+0];
+		PlanetPos[p][1] = GravityXyz[3*(p+1)+1];
+		PlanetPos[p][2] = GravityXyz[3*(p+1)+2];
+	}
+
+	// the close approaches, among the planets and the swarm:
+
+	SpatialUpdate( &Approaches, &GravityXyz[1*3], n - 1 );
+	SpatialPairs( &Approaches, CLOSE_APPROACH, &ClosePairs );
+}
+
+
+void
+DrawSwarm( )
+{
+	int first = 1 + NUMPLANETS;
+	int n = Gravity.n - first;
+	if( n <= 0 )
+		return;
+
+	glDisable( GL_LIGHTING );
+	glPointSize( ASTEROID_POINT_SIZE );
+	glColor3f( 0.4f, 0.7f, 1.0f );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 0, &GravityXyz[3*first] );
+	glDrawArrays( GL_POINTS, 0, n );
+	DrawCalls++;
+	VerticesSubmitted += n;
+	glPointSize( 1. );
+
+	// join each close pair with a red line:
+	// (the pairs are numbered from body 1, the Sun is not in the grid)
+
+	if( ! ClosePairs.empty( ) )
+	{
+		CloseLines.resize( 6 * ClosePairs.size( ) );
+		for( size_t k = 0; k < ClosePairs.size( ); k++ )
+		{
+			const float *a = &GravityXyz[ 3 * ( ClosePairs[k].a + 1 ) ];
+			const float *b = &GravityXyz[ 3 * ( ClosePairs[k].b + 1 ) ];
+			memcpy( &CloseLines[6*k+0], a, 3 * sizeof(float) );
+			memcpy( &CloseLines[6*k+3], b, 3 * sizeof(float) );
+		}
+		glColor3f( 1., 0.2f, 0.2f );
+		glVertexPointer( 3, GL_FLOAT, 0, &CloseLines[0] );
+		glDrawArrays( GL_LINES, 0, (GLsizei)( 2 * ClosePairs.size( ) ) );
+		DrawCalls++;
+		VerticesSubmitted += (int)( 2 * ClosePairs.size( ) );
+	}
+	glDisableClientState( GL_VERTEX_ARRAY );
+	glEnable( GL_LIGHTING );
+}
+
+
+///// Cpu benchmarks
+//
+// these time the simulation code on its own, without opening a window:
+//	-asteroidbench [n]		propagate n asteroids (default NUMASTEROIDS) for 120 frames
+//	-collisionbench [n]		find the close pairs among n (default 100000) moving bodies for 100 steps
+//	-cometbench [n]			shed tails from n comets (default NUMCOMETS) at perihelion for 120 frames
+//	-querybench [n]			ask for every body's position at n times, in bulk and one at a time
+//	-nbodybench [n]			integrate 10, 100, ... up to n bodies (default 1000000) with Barnes-Hut
+//	-mathbench [n]			multiply batches of n (default 4096) 4x4 matrices, plain C++ and SIMD
+//	-depthbench				find how far apart two surfaces must be not to z-fight, at each distance,
+//							with the standard depth buffer and reversed-Z, in the scene and at true scale
+
+bool
+RunCpuBenchmarks( int argc, char *argv[ ] )
+{
+	for( int i = 1; i < argc; i++ )
+	{
+		if( strcmp( argv[i], "-asteroidbench" ) == 0 )
+		{
+			int n = NUMASTEROIDS;
+			if( i+1 < argc  &&  argv[i+1][0] != '-' )
+				n = atoi( argv[i+1] );
+			if( n < 1 )
+				n = 1;
+			AsteroidsBenchmark( n, 120, ASTEROID_BUDGET_MS );
+			return true;
+		}
+		if( strcmp( argv[i], "-collisionbench" ) == 0 )
+		{
+			int n = 100000;
+			if( i+1 < argc  &&  argv[i+1][0] != '-' )
+				n = atoi( argv[++i] );
+			if( n < 2 )
+				n = 2;
+			SpatialBenchmark( n, 100 );
+			return true;
+		}
+		if( strcmp( argv[i], "-cometbench" ) == 0 )
+		{
+			int n = NUMCOMETS;
+			if( i+1 < argc  &&  argv[i+1][0] != '-' )
+				n = atoi( argv[++i] );
+			if( n < 1 )
+				n = 1;
+			CometsBenchmark( n, COMET_CAPACITY, 120 );
+			return true;
+		}
+		if( strcmp( argv[i], "-querybench" ) == 0 )
+		{
+			int n = 1000000;
+			if( i+1 < argc  &&  argv[i+1][0] != '-' )
+				n = atoi( argv[++i] );
+			if( n < 1 )
+				n = 1;
+			SolarModelBenchmark( n );
+			return true;
+		}
+		if( strcmp( argv[i], "-nbodybench" ) == 0 )
+		{
+			int n = 1000000;
+			if( i+1 < argc  &&  argv[i+1][0] != '-' )
+				n = atoi( argv[++i] );
+			if( n < 10 )
+				n = 10;
+			NBodyBenchmark( n, 20 );
+			return true;
+		}
+		if( strcmp( argv[i], "-mathbench" ) == 0 )
+		{
+			int n = 4096;
+			if( i+1 < argc  &&  argv[i+1][0] != '-' )
+				n = atoi( argv[++i] );
+			if( n < 1 )
+				n = 1;
+			VecMathBenchmark( n, 1000 );
+			return true;
+		}
+		if( strcmp( argv[i], "-depthbench" ) == 0 )
+		{
+			DepthBenchmark( 0.1, 1000., 1., 10., "units" );
+			DepthBenchmark( 1., 2. * TrueAxisKm[1+PLUTO], 1., 10., "km" );
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,365 @@
+//
+//	Close-approach detection -- see spatial.h.
+//
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "spatial.h"
+
+// the most threads the pair search is split across:
+
+const int SPATIAL_MAX_THREADS = { 16 };
+
+// past this fraction of the bodies changing cell in one step, the whole
+// order is radix sorted rather than merged:
+
+const float SPATIAL_MAX_MOVED = { 0.25f };
+
+// bits of the hash sorted per radix pass:
+
+const int SPATIAL_RADIX_BITS = { 8 };
+
+
+static double
+SpatialNowMs( )
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>( steady_clock::now( ).time_since_epoch( ) ).count( );
+}
+
+
+// a cell's bucket: its linear index wrapped into the table, so cells next to
+// each other along x are next to each other in the table, and sorting by it
+// keeps bodies that are close together close together in memory:
+
+static inline unsigned int
+CellHash( int ix, int iy, int iz, int bits )
+{
+	unsigned int h = (unsigned int)ix + (unsigned int)iy * 1021u + (unsigned int)iz * 1042441u;
+	return h & ( ( 1u << bits ) - 1u );
+}
+
+
+void
+SpatialInit( SpatialGrid *sg, float cell )
+{
+	sg->cell = cell;
+	sg->tableBits = 0;
+	sg->keys.clear( );
+	sg->order.clear( );
+	sg->sorted.clear( );
+	sg->buckets.clear( );
+	sg->threads = std::max( 1, std::min( (int)std::thread::hardware_concurrency( ), SPATIAL_MAX_THREADS ) );
+	sg->scratchKeys.clear( );
+	sg->scratchOrder.clear( );
+	sg->radix = false;
+	sg->moved = 0;
+	sg->sortMs = sg->queryMs = 0.;
+}
+
+
+// sort the slots by key, a few bits at a time from the bottom:
+
+static void
+RadixSort( SpatialGrid *sg )
+{
+	int n = (int)sg->keys.size( );
+	std::vector<unsigned int> keys2( n );
+	std::vector<int> order2( n );
+	const int buckets = 1 << SPATIAL_RADIX_BITS;
+	for( int shift = 0; shift < sg->tableBits; shift += SPATIAL_RADIX_BITS )
+	{
+		int histogram[1 << SPATIAL_RADIX_BITS] = { 0 };
+		for( int s = 0; s < n; s++ )
+			histogram[ ( sg->keys[s] >> shift ) & ( buckets - 1 ) ]++;
+		int sum = 0;
+		for( int b = 0; b < buckets; b++ )
+		{
+			int c = histogram[b];
+			histogram[b] = sum;
+			sum += c;
+		}
+		for( int s = 0; s < n; s++ )
+		{
+			int d = histogram[ ( sg->keys[s] >> shift ) & ( buckets - 1 ) ]++;
+			keys2[d] = sg->keys[s];
+			order2[d] = sg->order[s];
+		}
+		sg->keys.swap( keys2 );
+		sg->order.swap( order2 );
+	}
+}
+
+
+// re-sort the slots after only some of the keys have changed:
+// the bodies whose keys are unchanged are still in order, so the moved ones
+// are pulled out, sorted on their own and merged back in one linear pass
+// (returns false, changing nothing, if too many have moved for that to pay)
+
+static bool
+MergeMoved( SpatialGrid *sg, const std::vector<unsigned int> &newKeys )
+{
+	int n = (int)sg->keys.size( );
+	std::vector<std::pair<unsigned int, int> > moved;
+	for( int s = 0; s < n; s++ )
+	{
+		if( newKeys[s] != sg->keys[s] )
+			moved.push_back( std::make_pair( newKeys[s], sg->order[s] ) );
+	}
+	sg->moved = (int)moved.size( );
+	if( sg->moved > SPATIAL_MAX_MOVED * n )
+		return false;
+	std::sort( moved.begin( ), moved.end( ) );
+
+	sg->scratchKeys.resize( n );
+	sg->scratchOrder.resize( n );
+	int d = 0, m = 0;
+	for( int s = 0; s < n; s++ )
+	{
+		if( newKeys[s] != sg->keys[s] )
+			continue;
+		while( m < sg->moved  &&  moved[m].first < newKeys[s] )
+		{
+			sg->scratchKeys[d] = moved[m].first;
+			sg->scratchOrder[d++] = moved[m++].second;
+		}
+		sg->scratchKeys[d] = newKeys[s];
+		sg->scratchOrder[d++] = sg->order[s];
+	}
+	for( ; m < sg->moved; m++ )
+	{
+		sg->scratchKeys[d] = moved[m].first;
+		sg->scratchOrder[d++] = moved[m].second;
+	}
+	sg->keys.swap( sg->scratchKeys );
+	sg->order.swap( sg->scratchOrder );
+	return true;
+}
+
+
+// bring the grid up to date with the bodies' positions xyz[ 3*n ]:
+
+void
+SpatialUpdate( SpatialGrid *sg, const float *xyz, int n )
+{
+	double start = SpatialNowMs( );
+	bool fresh = (int)sg->order.size( ) != n;
+	if( fresh )
+	{
+		sg->tableBits = 10;
+		while( ( 1 << sg->tableBits ) < 2 * n  &&  sg->tableBits < 30 )
+			sg->tableBits++;
+		sg->order.resize( n );
+		for( int s = 0; s < n; s++ )
+			sg->order[s] = s;
+		sg->keys.resize( n );
+		sg->sorted.resize( 3 * (size_t)n );
+		sg->buckets.resize( (size_t)2 << sg->tableBits );
+	}
+
+	float inv = 1.f / sg->cell;
+	std::vector<unsigned int> newKeys( n );
+	for( int s = 0; s < n; s++ )
+	{
+		const float *p = &xyz[ 3 * sg->order[s] ];
+		newKeys[s] = CellHash( (int)floorf( p[0] * inv ), (int)floorf( p[1] * inv ), (int)floorf( p[2] * inv ),
+					sg->tableBits );
+	}
+
+	sg->radix = fresh  ||  ! MergeMoved( sg, newKeys );
+	if( sg->radix )
+	{
+		sg->keys.swap( newKeys );
+		RadixSort( sg );
+	}
+
+	// each bucket's run of slots, and the positions gathered into slot order
+	// so the pair search reads them contiguously:
+
+	std::fill( sg->buckets.begin( ), sg->buckets.end( ), 0 );
+	for( int s = 0; s < n; s++ )
+	{
+		unsigned int k = sg->keys[s];
+		if( sg->buckets[2*k+1]++ == 0 )
+			sg->buckets[2*k] = s;
+		const float *p = &xyz[ 3 * sg->order[s] ];
+		sg->sorted[3*s+0] = p[0];
+		sg->sorted[3*s+1] = p[1];
+		sg->sorted[3*s+2] = p[2];
+	}
+	sg->sortMs = SpatialNowMs( ) - start;
+}
+
+
+// the pairs with a body in slots first .. first+count-1 and the other in a
+// later slot:
+
+static void
+PairRange( const SpatialGrid *sg, float threshold, int first, int count, std::vector<SpatialPair> *pairs )
+{
+	float inv = 1.f / sg->cell;
+	float t2 = threshold * threshold;
+	for( int s = first; s < first + count; s++ )
+	{
+		const float *p = &sg->sorted[3*s];
+		int ix = (int)floorf( p[0] * inv ), iy = (int)floorf( p[1] * inv ), iz = (int)floorf( p[2] * inv );
+
+		// the 27 cells around, without visiting a bucket twice when two of them hash alike:
+		// (the mask on the low bits of the hashes makes the check for a repeat
+		//  almost always a single test)
+
+		unsigned int near[27];
+		int nb = 0;
+		unsigned long long mask = 0;
+		for( int dz = -1; dz <= 1; dz++ )
+		for( int dy = -1; dy <= 1; dy++ )
+		for( int dx = -1; dx <= 1; dx++ )
+		{
+			unsigned int k = CellHash( ix + dx, iy + dy, iz + dz, sg->tableBits );
+			unsigned long long bit = 1ull << ( k & 63 );
+			bool seen = false;
+			if( ( mask & bit ) != 0 )
+			{
+				for( int j = 0; j < nb  &&  ! seen; j++ )
+					seen = near[j] == k;
+			}
+			mask |= bit;
+			if( ! seen )
+				near[nb++] = k;
+		}
+
+		for( int j = 0; j < nb; j++ )
+		{
+			int c = sg->buckets[ 2*near[j] + 1 ];
+			if( c == 0 )
+				continue;
+			int t0 = sg->buckets[ 2*near[j] ];
+			for( int t = std::max( t0, s + 1 ); t < t0 + c; t++ )
+			{
+				const float *q = &sg->sorted[3*t];
+				float dx = q[0] - p[0], dy = q[1] - p[1], dz = q[2] - p[2];
+				float d2 = dx*dx + dy*dy + dz*dz;
+				if( d2 < t2 )
+				{
+					SpatialPair sp;
+					sp.a = std::min( sg->order[s], sg->order[t] );
+					sp.b = std::max( sg->order[s], sg->order[t] );
+					sp.d = sqrtf( d2 );
+					pairs->push_back( sp );
+				}
+			}
+		}
+	}
+}
+
+
+// every pair of bodies closer than threshold (no more than the cell size),
+// as of the last update, into pairs:
+
+void
+SpatialPairs( SpatialGrid *sg, float threshold, std::vector<SpatialPair> *pairs )
+{
+	double start = SpatialNowMs( );
+	pairs->clear( );
+	threshold = std::min( threshold, sg->cell );
+	int n = (int)sg->order.size( );
+	int nt = std::max( 1, std::min( sg->threads, n / 1024 ) );
+	int chunk = ( n + nt - 1 ) / nt;
+
+	std::vector<SpatialPair> found[SPATIAL_MAX_THREADS];
+	std::thread workers[SPATIAL_MAX_THREADS];
+	int nworkers = 0;
+	for( int first = chunk; first < n; first += chunk )
+	{
+		workers[nworkers] = std::thread( PairRange, sg, threshold, first, std::min( chunk, n - first ), &found[nworkers+1] );
+		nworkers++;
+	}
+	PairRange( sg, threshold, 0, std::min( chunk, n ), &found[0] );
+	for( int w = 0; w < nworkers; w++ )
+		workers[w].join( );
+
+	for( int w = 0; w <= nworkers; w++ )
+		pairs->insert( pairs->end( ), found[w].begin( ), found[w].end( ) );
+	sg->queryMs = SpatialNowMs( ) - start;
+}
+
+
+// the benchmark -- no window, just the grid:
+// n bodies drifting at random through a periodic box, dense enough that each
+// has about 0.1 others within the threshold, first checked against a brute
+// force search, then timed over the steps
+
+void
+SpatialBenchmark( int n, int steps )
+{
+	const float D = 1.f;				// the threshold, and the cell size
+	const float DENSITY = 0.05f;		// bodies per unit volume
+	const float SPEED = 0.05f;			// most a body moves per step on each axis
+	float L = cbrtf( n / DENSITY );
+
+	unsigned int state = 12345;
+	std::vector<float> xyz( 3 * (size_t)n ), vel( 3 * (size_t)n );
+	for( int i = 0; i < 3*n; i++ )
+	{
+		state ^= state << 13;	state ^= state >> 17;	state ^= state << 5;
+		float u = (float)( state >> 8 ) / (float)( 1 << 24 );
+		xyz[i] = L * u;
+		state ^= state << 13;	state ^= state >> 17;	state ^= state << 5;
+		vel[i] = SPEED * ( 2.f * (float)( state >> 8 ) / (float)( 1 << 24 ) - 1.f );
+	}
+
+	SpatialGrid sg;
+	SpatialInit( &sg, D );
+	std::vector<SpatialPair> pairs;
+	printf( "collisions: %d bodies, threshold %g, %d steps, %d threads\n", n, D, steps, sg.threads );
+
+	// the first step against every pair, on up to 10000 of the bodies:
+
+	int nc = std::min( n, 10000 );
+	SpatialUpdate( &sg, &xyz[0], nc );
+	SpatialPairs( &sg, D, &pairs );
+	long long brute = 0;
+	for( int i = 0; i < nc; i++ )
+	{
+		for( int j = i + 1; j < nc; j++ )
+		{
+			float dx = xyz[3*j] - xyz[3*i], dy = xyz[3*j+1] - xyz[3*i+1], dz = xyz[3*j+2] - xyz[3*i+2];
+			if( dx*dx + dy*dy + dz*dz < D*D )
+				brute++;
+		}
+	}
+	printf( "\tcheck on %d bodies: grid %d pairs, brute force %lld pairs\n", nc, (int)pairs.size( ), brute );
+
+	SpatialInit( &sg, D );
+	SpatialUpdate( &sg, &xyz[0], n );
+	printf( "\tfirst build (radix): %.3f ms\n", sg.sortMs );
+
+	double sortMs = 0., queryMs = 0.;
+	long long npairs = 0, moved = 0;
+	int radix = 0;
+	for( int s = 0; s < steps; s++ )
+	{
+		for( int i = 0; i < 3*n; i++ )
+		{
+			xyz[i] += vel[i];
+			if( xyz[i] < 0. )	xyz[i] += L;
+			if( xyz[i] >= L )	xyz[i] -= L;
+		}
+		SpatialUpdate( &sg, &xyz[0], n );
+		SpatialPairs( &sg, D, &pairs );
+		sortMs += sg.sortMs;
+		queryMs += sg.queryMs;
+		npairs += (long long)pairs.size( );
+		moved += sg.radix ? 0 : sg.moved;
+		radix += sg.radix ? 1 : 0;
+	}
+	printf( "\tper step: update %.3f ms (%.1f%% changed cell, %d radix rebuilds), pairs %.3f ms, %.1f pairs\n",
+		sortMs / steps, 100. * moved / n / std::max( 1, steps - radix ), radix, queryMs / steps,
+		(double)npairs / steps );
+}
@@ -0,0 +1,48 @@
+//
+//	Close-approach detection: a uniform grid over moving bodies that finds
+//	every pair closer than a threshold.
+//
+//	Bodies are kept sorted by the hash of the grid cell they are in, so each
+//	cell's bodies are one contiguous run. From one step to the next only a
+//	few bodies change cell, so only those are taken out, sorted among
+//	themselves and merged back into the rest, which are still in order;
+//	when too many have moved for that to pay, the whole order is rebuilt
+//	with a radix sort. The pair search then looks at each body's own and
+//	neighboring cells, split across threads.
+
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <vector>
+
+struct SpatialPair
+{
+	int		a, b;		// the two bodies, a < b
+	float	d;			// how far apart they are
+};
+
+struct SpatialGrid
+{
+	float						cell;		// width of a grid cell, at least the largest threshold asked for
+	int							tableBits;	// log2 of the # of cell hash buckets
+	std::vector<unsigned int>	keys;		// cell hash of the body in each sorted slot
+	std::vector<int>			order;		// the body in each sorted slot
+	std::vector<float>			sorted;		// the bodies' positions, in sorted order
+	std::vector<int>			buckets;	// first slot and # of slots of each hash bucket, side by side
+	int							threads;	// # of threads the pair search is split across
+
+	std::vector<unsigned int>	scratchKeys;	// room for the merge
+	std::vector<int>			scratchOrder;
+
+	bool						radix;		// true if the last update had to radix sort
+	int							moved;		// # of bodies that changed cell in the last update
+	double						sortMs;		// how long the last update took
+	double						queryMs;	// how long the last pair search took
+};
+
+void	SpatialInit( SpatialGrid *, float );
+void	SpatialUpdate( SpatialGrid *, const float *, int );
+void	SpatialPairs( SpatialGrid *, float, std::vector<SpatialPair> * );
+void	SpatialBenchmark( int, int );
+
+#endif
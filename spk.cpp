@@ -0,0 +1,328 @@
+//
+//	The SPK ephemeris reader -- see spk.h.
+//
+//	An SPK kernel is a DAF (double precision array file): 1024-byte records,
+//	the first one describing the file, then a chain of summary records, each
+//	listing segments by their coverage, ids and start and end addresses
+//	(1-based, in doubles). A type 2 or 3 segment ends with 4 doubles --
+//	the first record's start, the record span, the record size and the record
+//	count -- and each record holds its midpoint, its half span and the
+//	Chebyshev coefficients of x, y and z (then vx, vy and vz, for type 3).
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "spk.h"
+
+const int DAF_RECORD   = { 1024 };		// bytes per record
+const int SPK_ND       = { 2 };			// doubles in an SPK segment summary
+const int SPK_NI       = { 6 };			// ints in an SPK segment summary
+const int SPK_MAXHOPS  = { 8 };			// longest chain of centers followed back to the barycenter
+
+
+static bool
+HostIsLittleEndian( )
+{
+	unsigned short probe = 1;
+	return *(unsigned char *)&probe == 1;
+}
+
+
+static void
+SwapBytes( unsigned char *p, int n )
+{
+	for( int i = 0; i < n/2; i++ )
+	{
+		unsigned char t = p[i];
+		p[i] = p[n-1-i];
+		p[n-1-i] = t;
+	}
+}
+
+
+// read a double or an int at a byte offset, in the file's byte order:
+
+static double
+SpkDouble( const SpkFile *spk, size_t offset )
+{
+	double d;
+	memcpy( &d, spk->base + offset, sizeof(double) );
+	if( spk->swap )
+		SwapBytes( (unsigned char *)&d, sizeof(double) );
+	return d;
+}
+
+
+static int
+SpkInt( const SpkFile *spk, size_t offset )
+{
+	int i;
+	memcpy( &i, spk->base + offset, sizeof(int) );
+	if( spk->swap )
+		SwapBytes( (unsigned char *)&i, sizeof(int) );
+	return i;
+}
+
+
+// map the whole file read-only, without reading any of it:
+
+static bool
+MapFile( SpkFile *spk, const char *filename )
+{
+#ifdef WIN32
+	HANDLE file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+				FILE_FLAG_RANDOM_ACCESS, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+		return false;
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	void *view = NULL;
+	if( GetFileSizeEx( file, &size ) )
+		mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( mapping != NULL )
+		view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if( view == NULL )
+	{
+		if( mapping != NULL )
+			CloseHandle( mapping );
+		CloseHandle( file );
+		return false;
+	}
+	spk->base = (const unsigned char *)view;
+	spk->size = (size_t)size.QuadPart;
+	spk->handle = file;
+	spk->mapping = mapping;
+#else
+	int fd = open( filename, O_RDONLY );
+	if( fd < 0 )
+		return false;
+	struct stat st;
+	void *view = MAP_FAILED;
+	if( fstat( fd, &st ) == 0  &&  st.st_size > 0 )
+		view = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );		// the mapping keeps the file open
+	if( view == MAP_FAILED )
+		return false;
+	madvise( view, (size_t)st.st_size, MADV_RANDOM );		// no read-ahead: queries jump around
+	spk->base = (const unsigned char *)view;
+	spk->size = (size_t)st.st_size;
+	spk->handle = spk->mapping = NULL;
+#endif
+	return true;
+}
+
+
+// open a kernel and read its segment summaries:
+
+bool
+SpkOpen( SpkFile *spk, const char *filename )
+{
+	spk->base = NULL;
+	spk->size = 0;
+	spk->segments.clear( );
+	if( ! MapFile( spk, filename ) )
+	{
+		fprintf( stderr, "Cannot open SPK kernel '%s'\n", filename );
+		return false;
+	}
+
+	if( spk->size < (size_t)DAF_RECORD  ||  memcmp( spk->base, "DAF/SPK ", 8 ) != 0 )
+	{
+		fprintf( stderr, "'%s' is not an SPK kernel\n", filename );
+		SpkClose( spk );
+		return false;
+	}
+
+	// the byte order is named in the file record, except in very old files,
+	// where ND, which must be 2, gives it away:
+
+	if( memcmp( spk->base + 88, "LTL-IEEE", 8 ) == 0 )
+		spk->swap = ! HostIsLittleEndian( );
+	else if( memcmp( spk->base + 88, "BIG-IEEE", 8 ) == 0 )
+		spk->swap = HostIsLittleEndian( );
+	else
+	{
+		spk->swap = false;
+		spk->swap = SpkInt( spk, 8 ) != SPK_ND;
+	}
+
+	if( SpkInt( spk, 8 ) != SPK_ND  ||  SpkInt( spk, 12 ) != SPK_NI )
+	{
+		fprintf( stderr, "'%s' has a summary layout that is not SPK's\n", filename );
+		SpkClose( spk );
+		return false;
+	}
+
+	// follow the chain of summary records:
+
+	const int SS = SPK_ND + ( SPK_NI + 1 ) / 2;		// summary size, doubles
+	int record = SpkInt( spk, 76 );					// FWARD
+	int visited = 0;
+	while( record > 0  &&  (size_t)record * DAF_RECORD <= spk->size  &&  visited++ < 100000 )
+	{
+		size_t rec = (size_t)( record - 1 ) * DAF_RECORD;
+		int next = (int)SpkDouble( spk, rec );
+		int nsum = (int)SpkDouble( spk, rec + 16 );
+		for( int s = 0; s < nsum  &&  24 + ( s + 1 ) * SS * 8 <= DAF_RECORD; s++ )
+		{
+			size_t sum = rec + 24 + (size_t)s * SS * 8;
+			SpkSegment seg;
+			seg.start  = SpkDouble( spk, sum );
+			seg.end    = SpkDouble( spk, sum + 8 );
+			seg.target = SpkInt( spk, sum + 16 );
+			seg.center = SpkInt( spk, sum + 20 );
+			seg.frame  = SpkInt( spk, sum + 24 );
+			seg.type   = SpkInt( spk, sum + 28 );
+			int first  = SpkInt( spk, sum + 32 );
+			int last   = SpkInt( spk, sum + 36 );
+			if( ( seg.type != 2  &&  seg.type != 3 )  ||  first < 1  ||  last < first + 3
+				||  (size_t)last * 8 > spk->size )
+				continue;
+
+			size_t tail = (size_t)( last - 4 ) * 8;
+			seg.init   = SpkDouble( spk, tail );
+			seg.intlen = SpkDouble( spk, tail + 8 );
+			seg.rsize  = (int)SpkDouble( spk, tail + 16 );
+			seg.n      = (int)SpkDouble( spk, tail + 24 );
+			seg.data   = (size_t)( first - 1 ) * 8;
+			int perAxis = seg.type == 2 ? 3 : 6;
+			if( seg.intlen <= 0.  ||  seg.n < 1  ||  seg.rsize < 2 + perAxis
+				||  seg.data + (size_t)seg.rsize * seg.n * 8 > tail )
+				continue;
+			spk->segments.push_back( seg );
+		}
+		record = next;
+	}
+
+	if( spk->segments.empty( ) )
+	{
+		fprintf( stderr, "'%s' has no type 2 or 3 segments\n", filename );
+		SpkClose( spk );
+		return false;
+	}
+	return true;
+}
+
+
+void
+SpkClose( SpkFile *spk )
+{
+	if( spk->base == NULL )
+		return;
+#ifdef WIN32
+	UnmapViewOfFile( spk->base );
+	CloseHandle( (HANDLE)spk->mapping );
+	CloseHandle( (HANDLE)spk->handle );
+#else
+	munmap( (void *)spk->base, spk->size );
+#endif
+	spk->base = NULL;
+	spk->size = 0;
+	spk->segments.clear( );
+}
+
+
+// the segment for target at time et:
+// (where segments overlap, the one later in the file wins, as in SPICE)
+
+static const SpkSegment *
+FindSegment( const SpkFile *spk, int target, double et )
+{
+	for( int i = (int)spk->segments.size( ) - 1; i >= 0; i-- )
+	{
+		const SpkSegment *seg = &spk->segments[i];
+		if( seg->target == target  &&  et >= seg->start  &&  et <= seg->end )
+			return seg;
+	}
+	return NULL;
+}
+
+
+// target's position relative to the segment's center at et, summing each
+// axis's Chebyshev series by Clenshaw's recurrence straight from the map:
+
+static void
+SegmentPosition( const SpkFile *spk, const SpkSegment *seg, double et, double pos[3] )
+{
+	int k = (int)( ( et - seg->init ) / seg->intlen );
+	if( k < 0 )
+		k = 0;
+	if( k > seg->n - 1 )
+		k = seg->n - 1;
+
+	size_t rec = seg->data + (size_t)k * seg->rsize * 8;
+	double mid    = SpkDouble( spk, rec );
+	double radius = SpkDouble( spk, rec + 8 );
+	double x = ( et - mid ) / radius;
+	int ncoef = ( seg->rsize - 2 ) / ( seg->type == 2 ? 3 : 6 );
+
+	for( int axis = 0; axis < 3; axis++ )
+	{
+		size_t c = rec + 16 + (size_t)axis * ncoef * 8;
+		double b1 = 0., b2 = 0.;
+		for( int j = ncoef - 1; j >= 1; j-- )
+		{
+			double b0 = SpkDouble( spk, c + j*8 ) + 2. * x * b1 - b2;
+			b2 = b1;
+			b1 = b0;
+		}
+		pos[axis] = SpkDouble( spk, c ) + x * b1 - b2;
+	}
+}
+
+
+// a body's position relative to the solar system barycenter, following its
+// chain of centers (e.g., Earth -> Earth-Moon barycenter -> SSB):
+
+static bool
+BarycentricPosition( const SpkFile *spk, int body, double et, double pos[3] )
+{
+	pos[0] = pos[1] = pos[2] = 0.;
+	for( int hop = 0; body != SPK_SSB; hop++ )
+	{
+		const SpkSegment *seg = hop < SPK_MAXHOPS ? FindSegment( spk, body, et ) : NULL;
+		if( seg == NULL )
+			return false;
+		double p[3];
+		SegmentPosition( spk, seg, et, p );
+		pos[0] += p[0];
+		pos[1] += p[1];
+		pos[2] += p[2];
+		body = seg->center;
+	}
+	return true;
+}
+
+
+bool
+SpkCovers( const SpkFile *spk, int body, double et )
+{
+	double pos[3];
+	return spk->base != NULL  &&  BarycentricPosition( spk, body, et, pos );
+}
+
+
+// the position of target relative to observer at et (seconds past J2000), km:
+// (e.g., SpkPosition( spk, 399, SPK_SUN, et, pos ) is Earth's heliocentric position)
+
+bool
+SpkPosition( const SpkFile *spk, int target, int observer, double et, double pos[3] )
+{
+	double t[3], o[3];
+	if( spk->base == NULL  ||  ! BarycentricPosition( spk, target, et, t )
+		||  ! BarycentricPosition( spk, observer, et, o ) )
+		return false;
+	pos[0] = t[0] - o[0];
+	pos[1] = t[1] - o[1];
+	pos[2] = t[2] - o[2];
+	return true;
+}
@@ -0,0 +1,52 @@
+//
+//	A reader for JPL SPK ephemeris kernels (the DE-series .bsp files).
+//
+//	The kernel is memory-mapped rather than read: opening it only touches
+//	the file record and the segment summaries, and each position query
+//	touches just the page or two holding the Chebyshev record it needs, so
+//	a multi-hundred-MB kernel costs a few pages of memory per body in use.
+//
+//	Segments of type 2 (Chebyshev position) and type 3 (Chebyshev position
+//	and velocity) are supported, which covers the DE planetary kernels.
+//	Positions are in km in the kernel's frame, J2000 equatorial for the DE
+//	files, and times are ephemeris seconds past J2000.
+
+#ifndef SPK_H
+#define SPK_H
+
+#include <stddef.h>
+#include <vector>
+
+// NAIF ids of the bodies the chaining stops at:
+
+const int SPK_SSB = { 0 };			// solar system barycenter
+const int SPK_SUN = { 10 };
+
+struct SpkSegment
+{
+	int		target, center;		// NAIF ids: the segment gives target relative to center
+	int		frame;				// reference frame id, 1 is J2000
+	int		type;				// SPK data type, 2 or 3
+	double	start, end;			// coverage, ephemeris seconds past J2000
+	double	init, intlen;		// start of the first record and the span of each, seconds
+	int		rsize;				// doubles per record
+	int		n;					// # of records
+	size_t	data;				// byte offset of the first record in the file
+};
+
+struct SpkFile
+{
+	const unsigned char *	base;		// the mapped file, NULL if none is open
+	size_t					size;		// its length in bytes
+	bool					swap;		// true if the file's byte order is not the machine's
+	std::vector<SpkSegment>	segments;
+	void *					handle;		// platform mapping handles
+	void *					mapping;
+};
+
+bool	SpkOpen( SpkFile *, const char * );
+void	SpkClose( SpkFile * );
+bool	SpkCovers( const SpkFile *, int, double );
+bool	SpkPosition( const SpkFile *, int, int, double, double [3] );
+
+#endif
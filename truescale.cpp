@@ -0,0 +1,163 @@
+//
+//	True scale and the floating origin -- see truescale.h.
+//
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "truescale.h"
+
+// how long a flight from one body to another takes, wall-clock ms:
+
+const double TRUE_FLY_MS = { 3000. };
+
+// Newton steps of the double-precision Kepler solve:
+
+const int TRUE_KEPLER_ITERATIONS = { 8 };
+
+const double TrueRadiusKm[NUMTRUEBODIES] =
+{
+	695700.,			// Sun
+	2439.7,				// Mercury
+	6051.8,				// Venus
+	6371.0,				// Earth
+	3389.5,				// Mars
+	69911.,				// Jupiter
+	58232.,				// Saturn
+	25362.,				// Uranus
+	24622.,				// Neptune
+	1188.3,				// Pluto
+	1737.4,				// Luna
+	1821.6,				// Io
+	1560.8,				// Europa
+	2634.1,				// Ganymede
+	2410.3,				// Callisto
+	2574.7,				// Titan
+	1353.4,				// Triton
+	606.,				// Charon
+};
+
+const double TrueAxisKm[NUMTRUEBODIES] =
+{
+	0.,
+	57909050.,
+	108208000.,
+	149598023.,
+	227939200.,
+	778570000.,
+	1433530000.,
+	2872460000.,
+	4495060000.,
+	5906380000.,
+	384399.,
+	421700.,
+	670900.,
+	1070400.,
+	1882700.,
+	1221870.,
+	354759.,
+	19591.,
+};
+
+
+// body i of ks at time t (ms), its semi-major axis made a, in doubles:
+// (the same solve as KeplerPropagate( ), without its float shortcuts)
+
+static void
+PositionKm( const KeplerSet *ks, int i, double t, double a, double xyz[3] )
+{
+	double M = fmod( ks->M0[i] + ks->meanMotion[i] * t, 2. * M_PI );
+	double e = ks->e[i];
+	double E = M + ( M < 0. ? -0.85 : 0.85 ) * e;
+	for( int it = 0; it < TRUE_KEPLER_ITERATIONS; it++ )
+		E -= ( E - e * sin( E ) - M ) / ( 1. - e * cos( E ) );
+
+	double u = a * ( cos( E ) - e );
+	double v = a * sqrt( 1. - e*e ) * sin( E );
+	xyz[0] = u * ks->px[i] + v * ks->qx[i];
+	xyz[1] = u * ks->py[i] + v * ks->qy[i];
+	xyz[2] = u * ks->pz[i] + v * ks->qz[i];
+}
+
+
+// every body's heliocentric position at time t (ms), in km, into
+// xyz[ 3*NUMTRUEBODIES ]:
+
+void
+TrueScalePositions( const SolarModel *sm, double t, double *xyz )
+{
+	xyz[0] = xyz[1] = xyz[2] = 0.;
+	for( int p = 0; p < NUMPLANETS; p++ )
+		PositionKm( &sm->planets, p, t, TrueAxisKm[1+p], &xyz[ 3*(1+p) ] );
+
+	for( int m = 0; m < NUMMOONS; m++ )
+	{
+		int b = 1 + NUMPLANETS + m;
+		const double *planet = &xyz[ 3*( 1 + Moons[m].planet ) ];
+		PositionKm( &sm->moons, m, t, TrueAxisKm[b], &xyz[3*b] );
+		for( int k = 0; k < 3; k++ )
+			xyz[3*b + k] += planet[k];
+	}
+}
+
+
+// the floating origin: n positions taken relative to eye in doubles, and
+// only then made floats:
+
+void
+TrueScaleRebase( const double *xyz, int n, const double eye[3], float *out )
+{
+	for( int i = 0; i < n; i++ )
+		for( int k = 0; k < 3; k++ )
+			out[3*i + k] = (float)( xyz[3*i + k] - eye[k] );
+}
+
+
+void
+TrueCameraInit( TrueCamera *cam )
+{
+	cam->focus = 1 + EARTH;
+	cam->eye[0] = cam->eye[1] = cam->eye[2] = 0.;
+	cam->from[0] = cam->from[1] = cam->from[2] = 0.;
+	cam->flyStartMs = -1.;
+}
+
+
+// set off for body focus, starting from where the eye is now:
+
+void
+TrueCameraFocus( TrueCamera *cam, int focus, double nowMs )
+{
+	cam->focus = focus;
+	for( int k = 0; k < 3; k++ )
+		cam->from[k] = cam->eye[k];
+	cam->flyStartMs = nowMs;
+}
+
+
+// put the eye distance km from the focus body, in direction dir (a unit
+// vector from the body), or part of the way there while it is flying:
+// (xyz holds this frame's TrueScalePositions( ))
+
+void
+TrueCameraUpdate( TrueCamera *cam, const double *xyz, const float dir[3], double distance, double nowMs )
+{
+	const double *target = &xyz[ 3*cam->focus ];
+	double orbit[3];
+	for( int k = 0; k < 3; k++ )
+		orbit[k] = target[k] + distance * dir[k];
+
+	double u = 1.;
+	if( cam->flyStartMs >= 0. )
+	{
+		u = ( nowMs - cam->flyStartMs ) / TRUE_FLY_MS;
+		if( u >= 1. )
+		{
+			u = 1.;
+			cam->flyStartMs = -1.;
+		}
+		u = u * u * ( 3. - 2. * u );		// ease in and out
+	}
+	for( int k = 0; k < 3; k++ )
+		cam->eye[k] = cam->from[k] + u * ( orbit[k] - cam->from[k] );
+}
@@ -0,0 +1,47 @@
+//
+//	True scale: the Sun, planets and moons at their real sizes and distances.
+//
+//	The rest of the scene fudges both so that the whole system fits between
+//	clip planes 0.1 and 1000 units apart. Here positions are kilometres, kept
+//	in double precision on the CPU from the orbit solve onward. The camera is
+//	kept in double too. Each frame, every body is taken relative to the eye
+//	while still in doubles, and only then converted to float for GL. The
+//	numbers that reach GL are therefore small wherever the eye is looking
+//	from, and a planet's surface does not jitter as it would if positions
+//	some billions of kilometres from the Sun were held in floats.
+//
+//	The orbits are the same Keplerian elements the scene uses, with the real
+//	semi-major axes in place of the scene's.
+
+#ifndef TRUESCALE_H
+#define TRUESCALE_H
+
+#include "solarmodel.h"
+
+// the bodies: the Sun, then the planets and moons in solarmodel.h's order:
+
+const int NUMTRUEBODIES = { 1 + NUMBODIES };
+
+// the outer edge of Saturn's A ring:
+
+const double TRUE_RINGS_OUTER_KM = { 136775. };
+
+extern const double	TrueRadiusKm[NUMTRUEBODIES];
+extern const double	TrueAxisKm[NUMTRUEBODIES];		// semi-major axis about the Sun or the planet, 0. for the Sun
+
+struct TrueCamera
+{
+	int		focus;			// the body looked at
+	double	eye[3];			// where the eye is, heliocentric km
+	double	from[3];		// where it was when it set off for focus
+	double	flyStartMs;		// wall-clock time it set off, < 0. once it has arrived
+};
+
+void	TrueScalePositions( const SolarModel *, double, double * );
+void	TrueScaleRebase( const double *, int, const double [3], float * );
+
+void	TrueCameraInit( TrueCamera * );
+void	TrueCameraFocus( TrueCamera *, int, double );
+void	TrueCameraUpdate( TrueCamera *, const double *, const float [3], double, double );
+
+#endif
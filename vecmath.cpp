@@ -0,0 +1,573 @@
+//
+//	Vectors, quaternions and matrices -- see vecmath.h.
+//
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+#include <chrono>
+
+#include "vecmath.h"
+
+// the widest instruction set the compiler is targeting:
+
+#if defined(__AVX__)
+#define VECMATH_AVX
+#include <immintrin.h>
+#elif defined(__SSE__)  ||  defined(_M_X64)  ||  ( defined(_M_IX86_FP)  &&  _M_IX86_FP >= 1 )
+#define VECMATH_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)  ||  defined(_M_ARM64)
+#define VECMATH_NEON
+#include <arm_neon.h>
+#endif
+
+const float VECMATH_PI = { 3.14159265f };
+
+
+static double
+VecMathNowMs( )
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>( steady_clock::now( ).time_since_epoch( ) ).count( );
+}
+
+
+///// vectors
+
+float
+Vec3Dot( const float a[3], const float b[3] )
+{
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+
+// out = a x b:
+// (out may be a or b)
+
+void
+Vec3Cross( const float a[3], const float b[3], float out[3] )
+{
+	float x = a[1]*b[2] - a[2]*b[1];
+	float y = a[2]*b[0] - a[0]*b[2];
+	float z = a[0]*b[1] - a[1]*b[0];
+	out[0] = x;
+	out[1] = y;
+	out[2] = z;
+}
+
+
+// out = in made 1 long, returning how long in was:
+// (a zero vector is copied as it is)
+
+float
+Vec3Unit( const float in[3], float out[3] )
+{
+	float len = sqrtf( Vec3Dot( in, in ) );
+	float s = len > 0. ? 1.f / len : 1.f;
+	out[0] = in[0] * s;
+	out[1] = in[1] * s;
+	out[2] = in[2] * s;
+	return len;
+}
+
+
+///// quaternions
+
+// a turn of deg degrees about ( x, y, z ), which need not be unit length:
+
+void
+QuatAxisAngle( Quat *q, float deg, float x, float y, float z )
+{
+	float axis[3] = { x, y, z };
+	Vec3Unit( axis, axis );
+	float half = deg * VECMATH_PI / 360.f;
+	float s = sinf( half );
+	q->x = axis[0] * s;
+	q->y = axis[1] * s;
+	q->z = axis[2] * s;
+	q->w = cosf( half );
+}
+
+
+// c = a * b, the turn b followed by the turn a:
+// (c may be a or b)
+
+void
+QuatMultiply( const Quat *a, const Quat *b, Quat *c )
+{
+	Quat r;
+	r.x = a->w*b->x + a->x*b->w + a->y*b->z - a->z*b->y;
+	r.y = a->w*b->y - a->x*b->z + a->y*b->w + a->z*b->x;
+	r.z = a->w*b->z + a->x*b->y - a->y*b->x + a->z*b->w;
+	r.w = a->w*b->w - a->x*b->x - a->y*b->y - a->z*b->z;
+	*c = r;
+}
+
+
+// out = v turned by the unit quaternion q:
+// (out may be v)
+
+void
+QuatRotate( const Quat *q, const float v[3], float out[3] )
+{
+	float u[3] = { q->x, q->y, q->z };
+	float t[3], ut[3];
+	Vec3Cross( u, v, t );
+	for( int i = 0; i < 3; i++ )
+		t[i] *= 2.f;
+	Vec3Cross( u, t, ut );
+	for( int i = 0; i < 3; i++ )
+		out[i] = v[i] + q->w * t[i] + ut[i];
+}
+
+
+///// matrices
+
+void
+Mat4Identity( Mat4 *a )
+{
+	for( int i = 0; i < 16; i++ )
+		a->m[i] = ( i % 5 == 0 ) ? 1.f : 0.f;
+}
+
+
+void
+Mat4Translate( Mat4 *a, float x, float y, float z )
+{
+	Mat4Identity( a );
+	a->m[12] = x;
+	a->m[13] = y;
+	a->m[14] = z;
+}
+
+
+// a turn of deg degrees about +y, as glRotatef( deg, 0., 1., 0. ) makes:
+
+void
+Mat4RotateY( Mat4 *a, float deg )
+{
+	float rad = deg * VECMATH_PI / 180.f;
+	float c = cosf( rad );
+	float s = sinf( rad );
+	Mat4Identity( a );
+	a->m[0] = c;
+	a->m[2] = -s;
+	a->m[8] = s;
+	a->m[10] = c;
+}
+
+
+void
+Mat4Scale( Mat4 *a, float s )
+{
+	Mat4Identity( a );
+	a->m[0] = a->m[5] = a->m[10] = s;
+}
+
+
+// the rotation of a unit quaternion:
+
+void
+Mat4FromQuat( Mat4 *a, const Quat *q )
+{
+	float xx = q->x*q->x, yy = q->y*q->y, zz = q->z*q->z;
+	float xy = q->x*q->y, xz = q->x*q->z, yz = q->y*q->z;
+	float wx = q->w*q->x, wy = q->w*q->y, wz = q->w*q->z;
+	Mat4Identity( a );
+	a->m[0] = 1.f - 2.f*( yy + zz );
+	a->m[1] = 2.f*( xy + wz );
+	a->m[2] = 2.f*( xz - wy );
+	a->m[4] = 2.f*( xy - wz );
+	a->m[5] = 1.f - 2.f*( xx + zz );
+	a->m[6] = 2.f*( yz + wx );
+	a->m[8] = 2.f*( xz + wy );
+	a->m[9] = 2.f*( yz - wx );
+	a->m[10] = 1.f - 2.f*( xx + yy );
+}
+
+
+// the view from eye toward center, as gluLookAt( ) makes it:
+
+void
+Mat4LookAt( Mat4 *a, const float eye[3], const float center[3], const float up[3] )
+{
+	float f[3] = { center[0] - eye[0], center[1] - eye[1], center[2] - eye[2] };
+	float s[3], u[3];
+	Vec3Unit( f, f );
+	Vec3Cross( f, up, s );
+	Vec3Unit( s, s );
+	Vec3Cross( s, f, u );
+
+	Mat4Identity( a );
+	for( int i = 0; i < 3; i++ )
+	{
+		a->m[4*i + 0] = s[i];
+		a->m[4*i + 1] = u[i];
+		a->m[4*i + 2] = -f[i];
+	}
+	a->m[12] = -Vec3Dot( s, eye );
+	a->m[13] = -Vec3Dot( u, eye );
+	a->m[14] = Vec3Dot( f, eye );
+}
+
+
+// as gluPerspective( fovy, aspect, znear, zfar ) makes:
+
+void
+Mat4Perspective( Mat4 *a, float fovy, float aspect, float znear, float zfar )
+{
+	float f = 1.f / tanf( fovy * VECMATH_PI / 360.f );
+	for( int i = 0; i < 16; i++ )
+		a->m[i] = 0.;
+	a->m[0] = f / aspect;
+	a->m[5] = f;
+	a->m[10] = ( zfar + znear ) / ( znear - zfar );
+	a->m[11] = -1.;
+	a->m[14] = 2.f * zfar * znear / ( znear - zfar );
+}
+
+
+// as glOrtho( left, right, bottom, top, znear, zfar ) makes:
+
+void
+Mat4Ortho( Mat4 *a, float left, float right, float bottom, float top, float znear, float zfar )
+{
+	Mat4Identity( a );
+	a->m[0] = 2.f / ( right - left );
+	a->m[5] = 2.f / ( top - bottom );
+	a->m[10] = -2.f / ( zfar - znear );
+	a->m[12] = -( right + left ) / ( right - left );
+	a->m[13] = -( top + bottom ) / ( top - bottom );
+	a->m[14] = -( zfar + znear ) / ( zfar - znear );
+}
+
+
+// the reversed-Z versions, for a [0,1] clip range (glClipControl( ) with
+// GL_ZERO_TO_ONE): the near plane goes to depth 1 and the far one to 0, so
+// floating-point depth, densest near 0, has its precision far away where
+// 1/z has lost its own. The perspective one has no far plane at all:
+
+void
+Mat4PerspectiveReversed( Mat4 *a, float fovy, float aspect, float znear )
+{
+	float f = 1.f / tanf( fovy * VECMATH_PI / 360.f );
+	for( int i = 0; i < 16; i++ )
+		a->m[i] = 0.;
+	a->m[0] = f / aspect;
+	a->m[5] = f;
+	a->m[11] = -1.;
+	a->m[14] = znear;
+}
+
+
+void
+Mat4OrthoReversed( Mat4 *a, float left, float right, float bottom, float top, float znear, float zfar )
+{
+	Mat4Ortho( a, left, right, bottom, top, znear, zfar );
+	a->m[10] = 1.f / ( zfar - znear );
+	a->m[14] = zfar / ( zfar - znear );
+}
+
+
+// c[i] = a * b[i] for n matrices, one column at a time: each column of
+// the product is the columns of a weighted by one column of b[i]
+
+static void
+MultiplyScalar( const Mat4 *a, const Mat4 *b, Mat4 *c, int n )
+{
+	for( int i = 0; i < n; i++ )
+	{
+		const float *bm = b[i].m;
+		float *cm = c[i].m;
+		for( int col = 0; col < 4; col++ )
+		{
+			for( int row = 0; row < 4; row++ )
+			{
+				cm[ 4*col + row ] = a->m[ 0 + row ] * bm[ 4*col + 0 ]
+						  + a->m[ 4 + row ] * bm[ 4*col + 1 ]
+						  + a->m[ 8 + row ] * bm[ 4*col + 2 ]
+						  + a->m[ 12 + row ] * bm[ 4*col + 3 ];
+			}
+		}
+	}
+}
+
+
+#if defined(VECMATH_AVX)
+
+// two columns of the product at a time: a's columns repeated in both halves
+// of a register, each weight spread across its own half:
+
+static void
+MultiplySimd( const Mat4 *a, const Mat4 *b, Mat4 *c, int n )
+{
+	__m256 a0 = _mm256_broadcast_ps( (const __m128 *)&a->m[0] );
+	__m256 a1 = _mm256_broadcast_ps( (const __m128 *)&a->m[4] );
+	__m256 a2 = _mm256_broadcast_ps( (const __m128 *)&a->m[8] );
+	__m256 a3 = _mm256_broadcast_ps( (const __m128 *)&a->m[12] );
+	for( int i = 0; i < n; i++ )
+	{
+		for( int col = 0; col < 4; col += 2 )
+		{
+			__m256 bb = _mm256_loadu_ps( &b[i].m[4*col] );
+			__m256 r = _mm256_mul_ps( a0, _mm256_permute_ps( bb, 0x00 ) );
+			r = _mm256_add_ps( r, _mm256_mul_ps( a1, _mm256_permute_ps( bb, 0x55 ) ) );
+			r = _mm256_add_ps( r, _mm256_mul_ps( a2, _mm256_permute_ps( bb, 0xaa ) ) );
+			r = _mm256_add_ps( r, _mm256_mul_ps( a3, _mm256_permute_ps( bb, 0xff ) ) );
+			_mm256_storeu_ps( &c[i].m[4*col], r );
+		}
+	}
+}
+
+#elif defined(VECMATH_SSE)
+
+static void
+MultiplySimd( const Mat4 *a, const Mat4 *b, Mat4 *c, int n )
+{
+	__m128 a0 = _mm_loadu_ps( &a->m[0] );
+	__m128 a1 = _mm_loadu_ps( &a->m[4] );
+	__m128 a2 = _mm_loadu_ps( &a->m[8] );
+	__m128 a3 = _mm_loadu_ps( &a->m[12] );
+	for( int i = 0; i < n; i++ )
+	{
+		for( int col = 0; col < 4; col++ )
+		{
+			__m128 bb = _mm_loadu_ps( &b[i].m[4*col] );
+			__m128 r = _mm_mul_ps( a0, _mm_shuffle_ps( bb, bb, 0x00 ) );
+			r = _mm_add_ps( r, _mm_mul_ps( a1, _mm_shuffle_ps( bb, bb, 0x55 ) ) );
+			r = _mm_add_ps( r, _mm_mul_ps( a2, _mm_shuffle_ps( bb, bb, 0xaa ) ) );
+			r = _mm_add_ps( r, _mm_mul_ps( a3, _mm_shuffle_ps( bb, bb, 0xff ) ) );
+			_mm_storeu_ps( &c[i].m[4*col], r );
+		}
+	}
+}
+
+#elif defined(VECMATH_NEON)
+
+static void
+MultiplySimd( const Mat4 *a, const Mat4 *b, Mat4 *c, int n )
+{
+	float32x4_t a0 = vld1q_f32( &a->m[0] );
+	float32x4_t a1 = vld1q_f32( &a->m[4] );
+	float32x4_t a2 = vld1q_f32( &a->m[8] );
+	float32x4_t a3 = vld1q_f32( &a->m[12] );
+	for( int i = 0; i < n; i++ )
+	{
+		for( int col = 0; col < 4; col++ )
+		{
+			const float *bm = &b[i].m[4*col];
+			float32x4_t r = vmulq_n_f32( a0, bm[0] );
+			r = vmlaq_n_f32( r, a1, bm[1] );
+			r = vmlaq_n_f32( r, a2, bm[2] );
+			r = vmlaq_n_f32( r, a3, bm[3] );
+			vst1q_f32( &c[i].m[4*col], r );
+		}
+	}
+}
+
+#else
+
+static void
+MultiplySimd( const Mat4 *a, const Mat4 *b, Mat4 *c, int n )
+{
+	MultiplyScalar( a, b, c, n );
+}
+
+#endif
+
+
+// c = a * b:
+// (c must not be a or b)
+
+void
+Mat4Multiply( const Mat4 *a, const Mat4 *b, Mat4 *c )
+{
+	MultiplySimd( a, b, c, 1 );
+}
+
+
+// c[i] = a * b[i] for i = 0 .. n-1, a's columns loaded once for all of them:
+// (no c[i] may be a or any b[j])
+
+void
+Mat4MultiplyBatch( const Mat4 *a, const Mat4 *b, Mat4 *c, int n )
+{
+	MultiplySimd( a, b, c, n );
+}
+
+
+// out = a * ( in, 1. ), without the divide by w:
+// (out may be in)
+
+void
+Mat4TransformPoint( const Mat4 *a, const float in[3], float out[3] )
+{
+	float x = in[0], y = in[1], z = in[2];
+	for( int i = 0; i < 3; i++ )
+		out[i] = a->m[i]*x + a->m[4+i]*y + a->m[8+i]*z + a->m[12+i];
+}
+
+
+// the six planes bounding what a projection * view matrix can see, as
+// ( nx, ny, nz, d ) with unit normals pointing in:
+// (a point p is inside a plane when n . p + d >= 0.)
+
+void
+Mat4FrustumPlanes( const Mat4 *a, float planes[6][4] )
+{
+	for( int p = 0; p < 6; p++ )
+	{
+		int row = p / 2;
+		float sign = ( p % 2 == 0 ) ? 1.f : -1.f;
+		for( int j = 0; j < 4; j++ )
+			planes[p][j] = a->m[4*j + 3] + sign * a->m[4*j + row];
+		float len = sqrtf( Vec3Dot( planes[p], planes[p] ) );
+		if( len > 0. )
+			for( int j = 0; j < 4; j++ )
+				planes[p][j] /= len;
+	}
+}
+
+
+// false when the sphere of radius r around c is wholly outside the planes:
+
+bool
+SphereInFrustum( const float planes[6][4], const float c[3], float r )
+{
+	for( int p = 0; p < 6; p++ )
+	{
+		if( Vec3Dot( planes[p], c ) + planes[p][3] < -r )
+			return false;
+	}
+	return true;
+}
+
+
+// true when the sphere of radius r around c is wholly hidden behind the
+// one of radius R around o, both in eye coordinates: inside the cone from
+// the eye that o's sphere fills -- the cylinder along -z, for an
+// orthographic view -- and further off than where the cone touches it,
+// beyond which every point of the cone is behind its surface:
+
+bool
+SphereOccluded( const float c[3], float r, const float o[3], float R, bool ortho )
+{
+	if( ortho )
+	{
+		float dx = c[0] - o[0];
+		float dy = c[1] - o[1];
+		return sqrtf( dx*dx + dy*dy ) + r <= R  &&  -c[2] - r >= -o[2];
+	}
+
+	float dc = sqrtf( Vec3Dot( c, c ) );
+	float doc = sqrtf( Vec3Dot( o, o ) );
+	if( doc <= R  ||  dc <= r )
+		return false;
+	if( dc - r < sqrtf( doc*doc - R*R ) )
+		return false;
+	float cosine = Vec3Dot( c, o ) / ( dc * doc );
+	if( cosine > 1.f )
+		cosine = 1.f;
+	if( cosine < -1.f )
+		cosine = -1.f;
+	return acosf( cosine ) + asinf( r / dc ) <= asinf( R / doc );
+}
+
+
+// true when the sphere of radius r around c may be in the shadow, umbra or
+// penumbra, that the one of radius R around o casts from a light of radius
+// S around s: inside the cone tangent to both the light and o that crosses
+// between them -- its apex L R / ( S + R ) short of o, on the axis, and
+// sin( half angle ) = ( S + R ) / L, for L = |o-s| -- grown by r, and not
+// wholly on the light's side of o:
+
+bool
+SphereInShadow( const float c[3], float r, const float o[3], float R, const float s[3], float S )
+{
+	float axis[3] = { o[0] - s[0], o[1] - s[1], o[2] - s[2] };
+	float length = Vec3Unit( axis, axis );
+	if( length <= 0. )
+		return false;
+
+	float rel[3] = { c[0] - o[0], c[1] - o[1], c[2] - o[2] };
+	float along = Vec3Dot( rel, axis );
+	if( along < -( r + R ) )
+		return false;
+	float sine = ( S + R ) / length;
+	if( sine >= 1. )
+		return true;			// the light and o overlap: no cone to speak of
+	float cosine = sqrtf( 1.f - sine * sine );
+	float reach = ( along + length * R / ( S + R ) ) * sine / cosine + r / cosine;
+	if( reach < 0. )
+		return false;
+	return Vec3Dot( rel, rel ) - along * along <= reach * reach;
+}
+
+
+const char *
+VecMathIsa( )
+{
+#if defined(VECMATH_AVX)
+	return "avx";
+#elif defined(VECMATH_SSE)
+	return "sse";
+#elif defined(VECMATH_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+
+
+// time batches of n multiplies, reps times, with the plain C++ loop and
+// with the SIMD one, and check the two agree:
+
+void
+VecMathBenchmark( int n, int reps )
+{
+	std::vector<Mat4> b( n ), scalar( n ), simd( n );
+	Mat4 a;
+	Quat q;
+	QuatAxisAngle( &q, 37.f, 1.f, 2.f, 3.f );
+	Mat4FromQuat( &a, &q );
+	a.m[12] = 1.5f;
+	a.m[13] = -2.f;
+	a.m[14] = 3.f;
+	for( int i = 0; i < n; i++ )
+	{
+		QuatAxisAngle( &q, (float)( i % 360 ), 1.f, (float)( i % 7 ), 2.f );
+		Mat4FromQuat( &b[i], &q );
+		b[i].m[12] = (float)( i % 100 );
+		b[i].m[14] = (float)( i % 37 );
+	}
+
+	// each batch moves a and reads back a product, so none can be skipped:
+	float sumScalar = 0., sumSimd = 0.;
+	double t0 = VecMathNowMs( );
+	for( int r = 0; r < reps; r++ )
+	{
+		a.m[13] = (float)r;
+		MultiplyScalar( &a, &b[0], &scalar[0], n );
+		sumScalar += scalar[ r % n ].m[13];
+	}
+	double t1 = VecMathNowMs( );
+	for( int r = 0; r < reps; r++ )
+	{
+		a.m[13] = (float)r;
+		Mat4MultiplyBatch( &a, &b[0], &simd[0], n );
+		sumSimd += simd[ r % n ].m[13];
+	}
+	double t2 = VecMathNowMs( );
+
+	float worst = 0.;
+	for( int i = 0; i < n; i++ )
+		for( int j = 0; j < 16; j++ )
+			worst = fmaxf( worst, fabsf( scalar[i].m[j] - simd[i].m[j] ) );
+
+	double count = (double)n * reps;
+	printf( "vecmath: %d matrices x %d batches, %s\n", n, reps, VecMathIsa( ) );
+	printf( "\tscalar %7.2f ns/multiply   simd %7.2f ns/multiply   %5.2fx   max difference %g\n",
+		( t1 - t0 ) * 1.e6 / count, ( t2 - t1 ) * 1.e6 / count, ( t1 - t0 ) / ( t2 - t1 ), fmaxf( worst, fabsf( sumScalar - sumSimd ) ) );
+}
@@ -0,0 +1,60 @@
+//
+//	Vectors, quaternions and 4x4 matrices on the CPU.
+//
+//	Every transform the scene uses is built here, not on the GL matrix stack:
+//	the projection, the camera's view and each body's model matrix. The CPU
+//	therefore knows where everything is, and the matrices are handed to GL
+//	already made, with glLoadMatrixf( ).
+//
+//	4x4 multiplies are the only hot operation -- one per body per frame, done
+//	in batches by Mat4MultiplyBatch( ) -- so they are the part written with
+//	SIMD: AVX (two columns at a time), SSE or NEON, whichever the compiler
+//	targets, with a plain C++ fallback. Vectors and quaternions are 3 or 4
+//	floats used a few times a frame and stay scalar.
+//
+//	Matrices are column-major, as glMultMatrixf( ) and glLoadMatrixf( ) take them.
+
+#ifndef VECMATH_H
+#define VECMATH_H
+
+struct Mat4
+{
+	float	m[16];
+};
+
+struct Quat
+{
+	float	x, y, z;		// the axis times sin( angle/2 )
+	float	w;				// cos( angle/2 )
+};
+
+float	Vec3Dot( const float [3], const float [3] );
+void	Vec3Cross( const float [3], const float [3], float [3] );
+float	Vec3Unit( const float [3], float [3] );
+
+void	QuatAxisAngle( Quat *, float, float, float, float );
+void	QuatMultiply( const Quat *, const Quat *, Quat * );
+void	QuatRotate( const Quat *, const float [3], float [3] );
+
+void	Mat4Identity( Mat4 * );
+void	Mat4Translate( Mat4 *, float, float, float );
+void	Mat4RotateY( Mat4 *, float );
+void	Mat4Scale( Mat4 *, float );
+void	Mat4FromQuat( Mat4 *, const Quat * );
+void	Mat4LookAt( Mat4 *, const float [3], const float [3], const float [3] );
+void	Mat4Perspective( Mat4 *, float, float, float, float );
+void	Mat4Ortho( Mat4 *, float, float, float, float, float, float );
+void	Mat4PerspectiveReversed( Mat4 *, float, float, float );
+void	Mat4OrthoReversed( Mat4 *, float, float, float, float, float, float );
+void	Mat4Multiply( const Mat4 *, const Mat4 *, Mat4 * );
+void	Mat4MultiplyBatch( const Mat4 *, const Mat4 *, Mat4 *, int );
+void	Mat4TransformPoint( const Mat4 *, const float [3], float [3] );
+void	Mat4FrustumPlanes( const Mat4 *, float [6][4] );
+bool	SphereInFrustum( const float [6][4], const float [3], float );
+bool	SphereOccluded( const float [3], float, const float [3], float, bool );
+bool	SphereInShadow( const float [3], float, const float [3], float, const float [3], float );
+
+const char *	VecMathIsa( );
+void			VecMathBenchmark( int, int );
+
+#endif